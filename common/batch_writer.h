@@ -0,0 +1,211 @@
+#ifndef OSI_BATCH_WRITER_H
+#define OSI_BATCH_WRITER_H
+
+// ----------------------------------------------
+// Буферизованная запись принятых строк в файл.
+//
+// Короткие строки копируются в накопительный буфер и уходят в файл одним
+// writev(), когда набралось flush_bytes байт или самым старым данным больше
+// flush_ms миллисекунд. Длинные строки (>= BW_DIRECT_MIN) не копируются:
+// они добавляются в тот же writev() отдельным элементом iovec прямо из
+// памяти вызывающего и сбрасываются сразу.
+//
+// Порог по времени проверяется при добавлении строки, поэтому, пока ввода
+// нет, его должен соблюдать вызывающий: перед тем как заснуть в ожидании
+// ввода, он спит не дольше bw_due_ms() и затем вызывает bw_flush_if_due().
+//
+// Настройки берутся из окружения (наследуется через fork/exec):
+//   WRITER_FLUSH_BYTES — порог по объёму (0 — писать каждую строку сразу)
+//   WRITER_FLUSH_MS    — порог по времени (0 — не ограничивать)
+//   WRITER_FSYNC       — none | flush | close: когда вызывать fdatasync()
+// ----------------------------------------------
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#define BW_DEFAULT_FLUSH_BYTES  (256 * 1024)
+#define BW_DEFAULT_FLUSH_MS     100
+#define BW_DIRECT_MIN           (16 * 1024)
+#define BW_MAX_IOV              4
+
+typedef enum {
+    BW_FSYNC_NONE,     // полагаемся на page cache
+    BW_FSYNC_FLUSH,    // fdatasync после каждого сброса
+    BW_FSYNC_CLOSE     // один fdatasync при закрытии
+} bw_fsync_policy_t;
+
+typedef struct {
+    int fd;
+    char *buf;                  // накопительный буфер
+    size_t cap;
+    size_t used;
+    size_t flush_bytes;
+    long flush_ms;
+    bw_fsync_policy_t fsync_policy;
+    struct timespec oldest;     // когда в пустой буфер легла первая строка
+} batch_writer_t;
+
+//------------------------------------------------------------------------------
+static inline long bw_env_long(const char *name, long fallback)
+{
+    const char *v = getenv(name);
+    return (v && *v) ? atol(v) : fallback;
+}
+
+static inline long bw_elapsed_ms(const struct timespec *since)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000L + (now.tv_nsec - since->tv_nsec) / 1000000L;
+}
+
+//------------------------------------------------------------------------------
+// Возвращает 0 или -1 (нет памяти)
+static inline int bw_init(batch_writer_t *w, int fd)
+{
+    long flush_bytes = bw_env_long("WRITER_FLUSH_BYTES", BW_DEFAULT_FLUSH_BYTES);
+
+    w->fd = fd;
+    w->used = 0;
+    w->flush_bytes = flush_bytes > 0 ? (size_t)flush_bytes : 0;
+    w->flush_ms = bw_env_long("WRITER_FLUSH_MS", BW_DEFAULT_FLUSH_MS);
+
+    const char *policy = getenv("WRITER_FSYNC");
+    w->fsync_policy = BW_FSYNC_NONE;
+    if (policy && strcmp(policy, "flush") == 0) {
+        w->fsync_policy = BW_FSYNC_FLUSH;
+    } else if (policy && strcmp(policy, "close") == 0) {
+        w->fsync_policy = BW_FSYNC_CLOSE;
+    }
+
+    // Буфер держим не меньше BW_DIRECT_MIN, чтобы короткая строка всегда влезала
+    w->cap = w->flush_bytes > BW_DIRECT_MIN ? w->flush_bytes : BW_DIRECT_MIN;
+    w->buf = malloc(w->cap);
+    return w->buf ? 0 : -1;
+}
+
+//------------------------------------------------------------------------------
+// Записать iovec целиком, дописывая хвост после частичных writev()
+static inline int bw_writev_all(int fd, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t n = writev(fd, iov, iovcnt);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+// Сбросить накопленное вместе с (необязательным) внешним куском
+static inline int bw_flush_with(batch_writer_t *w, const char *extra, size_t extra_len)
+{
+    struct iovec iov[BW_MAX_IOV];
+    int iovcnt = 0;
+
+    if (w->used > 0) {
+        iov[iovcnt].iov_base = w->buf;
+        iov[iovcnt].iov_len = w->used;
+        iovcnt++;
+    }
+    if (extra_len > 0) {
+        iov[iovcnt].iov_base = (char *)extra;
+        iov[iovcnt].iov_len = extra_len;
+        iovcnt++;
+    }
+    if (iovcnt == 0) {
+        return 0;
+    }
+
+    w->used = 0;
+    if (bw_writev_all(w->fd, iov, iovcnt) < 0) {
+        return -1;
+    }
+    if (w->fsync_policy == BW_FSYNC_FLUSH && fdatasync(w->fd) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static inline int bw_flush(batch_writer_t *w)
+{
+    return bw_flush_with(w, NULL, 0);
+}
+
+// Через сколько миллисекунд накопленное пора сбросить: 0 — уже пора,
+// -1 — ждать нечего (буфер пуст или порог по времени выключен)
+static inline long bw_due_ms(const batch_writer_t *w)
+{
+    if (w->used == 0 || w->flush_ms <= 0) {
+        return -1;
+    }
+    long left = w->flush_ms - bw_elapsed_ms(&w->oldest);
+    return left > 0 ? left : 0;
+}
+
+// Сбросить накопленное, если самым старым данным уже flush_ms
+static inline int bw_flush_if_due(batch_writer_t *w)
+{
+    return bw_due_ms(w) == 0 ? bw_flush(w) : 0;
+}
+
+//------------------------------------------------------------------------------
+// Добавить кусок (обычно строку вместе с '\n'). Память data после возврата
+// можно переиспользовать. Возвращает 0 или -1 при ошибке записи (errno).
+static inline int bw_append(batch_writer_t *w, const char *data, size_t len)
+{
+    if (len >= BW_DIRECT_MIN) {
+        // Длинная строка: без копирования, одним writev с накопленным
+        return bw_flush_with(w, data, len);
+    }
+
+    if (w->used + len > w->cap && bw_flush(w) < 0) {
+        return -1;
+    }
+    if (w->used == 0 && w->flush_ms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &w->oldest);
+    }
+    memcpy(w->buf + w->used, data, len);
+    w->used += len;
+
+    if (w->used >= w->flush_bytes) {
+        return bw_flush(w);
+    }
+    if (w->flush_ms > 0 && bw_elapsed_ms(&w->oldest) >= w->flush_ms) {
+        return bw_flush(w);
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// Сбросить остаток, применить политику fsync и освободить буфер.
+// Дескриптор не закрывается — он принадлежит вызывающему.
+static inline int bw_close(batch_writer_t *w)
+{
+    int rc = bw_flush(w);
+    if (rc == 0 && w->fsync_policy == BW_FSYNC_CLOSE && fdatasync(w->fd) < 0) {
+        rc = -1;
+    }
+    free(w->buf);
+    w->buf = NULL;
+    return rc;
+}
+
+#endif // OSI_BATCH_WRITER_H
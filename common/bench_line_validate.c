@@ -0,0 +1,176 @@
+// ----------------------------------------------
+// Микробенчмарк ядра проверки строк (line_validate.h) против построчного кода
+// клиентов lab1/lab3.
+//
+// Сборка и запуск:
+//     gcc -O2 -o bench_line_validate bench_line_validate.c
+//     ./bench_line_validate [число_строк] [средняя_длина]
+//
+// Для каждого варианта печатается время прохода по одному и тому же буферу,
+// МБ/с, строк/с и число принятых строк (должно совпадать у всех вариантов).
+// ----------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "line_framer.h"
+#include "line_validate.h"
+
+#define BATCH_LINES 4096
+#define ROUNDS 5
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+//------------------------------------------------------------------------------
+// Как в клиенте lab3: строка приходит NUL-терминированной (слот shm),
+// копируется strncpy в локальный буфер, длина — strlen.
+static size_t run_lab3_style(char **lines, size_t count)
+{
+    size_t accepted = 0;
+    char buf[4096];
+    for (size_t i = 0; i < count; i++) {
+        memset(buf, 0, sizeof(buf));
+        strncpy(buf, lines[i], sizeof(buf) - 1);
+        size_t len = strlen(buf);
+        if (len > 0 && (buf[len - 1] == '.' || buf[len - 1] == ';')) {
+            accepted++;
+        }
+    }
+    return accepted;
+}
+
+// Как в клиенте lab1: фреймер ищет '\n' memchr'ом, проверка по индексу
+static size_t run_lab1_style(const char *data, size_t size)
+{
+    line_framer_t f;
+    lf_init(&f);
+    lf_begin(&f, data, size);
+
+    size_t accepted = 0;
+    const char *line;
+    size_t len;
+    while (lf_next(&f, &line, &len) == 1) {
+        if (len >= 2 && (line[len - 2] == ';' || line[len - 2] == '.')) {
+            accepted++;
+        }
+    }
+    lf_destroy(&f);
+    return accepted;
+}
+
+static size_t run_kernel(lv_scan_fn scan, const char *data, size_t size)
+{
+    static uint32_t ends[BATCH_LINES];
+    static uint64_t ok_bits[BATCH_LINES / 64];
+    size_t accepted = 0;
+    size_t pos = 0;
+
+    while (pos < size) {
+        size_t consumed;
+        size_t n = scan(data + pos, size - pos, pos > 0 ? data[pos - 1] : '\n',
+                        ends, ok_bits, BATCH_LINES, &consumed);
+        for (size_t w = 0; w < (n + 63) / 64; w++) {
+            uint64_t bits = ok_bits[w];
+            if (w == n / 64) {
+                bits &= (n % 64) ? (1ULL << (n % 64)) - 1 : ~0ULL;
+            }
+            accepted += (size_t)__builtin_popcountll(bits);
+        }
+        if (consumed == 0) {
+            break;
+        }
+        pos += consumed;
+    }
+    return accepted;
+}
+
+//------------------------------------------------------------------------------
+static void report(const char *name, double best, size_t size, size_t count, size_t accepted)
+{
+    printf("%-16s %9.3f ms %9.1f MB/s %12.0f lines/s  accepted=%zu\n",
+           name, best * 1e3, (double)size / best / 1e6, (double)count / best, accepted);
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? (size_t)atol(argv[1]) : 2000000;
+    size_t avg_len = argc > 2 ? (size_t)atol(argv[2]) : 40;
+
+    // Строки случайной длины, примерно треть без правильного окончания
+    char *data = malloc(count * (2 * avg_len + 2));
+    char **lines = malloc(count * sizeof(char *));
+    char *store = malloc(count * (2 * avg_len + 2));
+    if (!data || !lines || !store) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    srand(42);
+    size_t size = 0;
+    char *sp = store;
+    for (size_t i = 0; i < count; i++) {
+        size_t len = 1 + (size_t)rand() % (2 * avg_len);
+        char *line = data + size;
+        for (size_t j = 0; j < len; j++) {
+            line[j] = (char)('a' + rand() % 26);
+        }
+        int kind = rand() % 3;
+        line[len - 1] = kind == 0 ? ';' : kind == 1 ? '.' : 'x';
+        line[len] = '\n';
+
+        memcpy(sp, line, len);
+        sp[len] = '\0';
+        lines[i] = sp;
+        sp += len + 1;
+        size += len + 1;
+    }
+
+    printf("%zu lines, %zu bytes\n", count, size);
+
+    const char *names[] = {"lab3 per-line", "lab1 per-line", "kernel scalar",
+#ifdef LV_HAVE_X86
+                           "kernel sse2", "kernel avx2",
+#endif
+    };
+    size_t variants = sizeof(names) / sizeof(names[0]);
+
+    for (size_t v = 0; v < variants; v++) {
+#ifdef LV_HAVE_X86
+        if (v == 4 && !__builtin_cpu_supports("avx2")) {
+            printf("%-16s skipped: no AVX2\n", names[v]);
+            continue;
+        }
+#endif
+        double best = 1e30;
+        size_t accepted = 0;
+        for (int r = 0; r < ROUNDS; r++) {
+            double t0 = now_sec();
+            switch (v) {
+                case 0: accepted = run_lab3_style(lines, count); break;
+                case 1: accepted = run_lab1_style(data, size); break;
+                case 2: accepted = run_kernel(lv_scan_scalar, data, size); break;
+#ifdef LV_HAVE_X86
+                case 3: accepted = run_kernel(lv_scan_sse2, data, size); break;
+                case 4: accepted = run_kernel(lv_scan_avx2, data, size); break;
+#endif
+            }
+            double t = now_sec() - t0;
+            if (t < best) {
+                best = t;
+            }
+        }
+        report(names[v], best, size, count, accepted);
+    }
+
+    free(data);
+    free(lines);
+    free(store);
+    return 0;
+}
@@ -0,0 +1,147 @@
+#ifndef OSI_LINE_FRAMER_H
+#define OSI_LINE_FRAMER_H
+
+// ----------------------------------------------
+// Разбиение потока байт на строки.
+//
+// read() возвращает произвольные куски: в одном может оказаться много строк,
+// а строка может оборваться на границе куска. Фреймер выдаёт только целые
+// строки (вместе с '\n'): строки, целиком лежащие в куске, отдаются прямо
+// из него без копирования, а оборванный хвост копится в буфере переноса
+// и дополняется началом следующего куска.
+//
+// Использование:
+//     lf_begin(&f, buf, n);
+//     while ((rc = lf_next(&f, &line, &len)) > 0) { ... }
+//     // rc == -1 — не хватило памяти под перенос
+// В конце потока lf_finish() отдаёт последнюю строку без '\n' (если есть),
+// дописав ей '\n'.
+// ----------------------------------------------
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char *chunk;          // текущий кусок (память вызывающего)
+    size_t chunk_len;
+    size_t pos;
+    char *carry;                // хвост незавершённой строки
+    size_t carry_len;
+    size_t carry_cap;
+} line_framer_t;
+
+//------------------------------------------------------------------------------
+static inline void lf_init(line_framer_t *f)
+{
+    memset(f, 0, sizeof(*f));
+}
+
+static inline void lf_destroy(line_framer_t *f)
+{
+    free(f->carry);
+    f->carry = NULL;
+    f->carry_len = f->carry_cap = 0;
+}
+
+static inline int lf_carry_append(line_framer_t *f, const char *data, size_t len)
+{
+    if (f->carry_len + len > f->carry_cap) {
+        size_t cap = f->carry_cap ? f->carry_cap : 4096;
+        while (cap < f->carry_len + len) {
+            cap *= 2;
+        }
+        char *p = realloc(f->carry, cap);
+        if (!p) {
+            return -1;
+        }
+        f->carry = p;
+        f->carry_cap = cap;
+    }
+    memcpy(f->carry + f->carry_len, data, len);
+    f->carry_len += len;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// Начать разбор очередного куска. Кусок должен жить до последнего lf_next().
+static inline void lf_begin(line_framer_t *f, const char *chunk, size_t len)
+{
+    f->chunk = chunk;
+    f->chunk_len = len;
+    f->pos = 0;
+}
+
+// Следующая целая строка: 1 — есть (line/len, включая '\n'), 0 — кусок
+// исчерпан (хвост перенесён), -1 — нет памяти. Строка действительна
+// до следующего вызова lf_next()/lf_finish().
+static inline int lf_next(line_framer_t *f, const char **line, size_t *len)
+{
+    if (f->pos >= f->chunk_len) {
+        return 0;
+    }
+
+    const char *start = f->chunk + f->pos;
+    size_t avail = f->chunk_len - f->pos;
+    const char *nl = memchr(start, '\n', avail);
+    if (!nl) {
+        f->pos = f->chunk_len;
+        return lf_carry_append(f, start, avail);
+    }
+
+    size_t n = (size_t)(nl - start) + 1;
+    f->pos += n;
+
+    if (f->carry_len == 0) {
+        *line = start;
+        *len = n;
+        return 1;
+    }
+
+    // Начало строки пришло в прошлом куске — собираем её в буфере переноса
+    if (lf_carry_append(f, start, n) < 0) {
+        return -1;
+    }
+    *line = f->carry;
+    *len = f->carry_len;
+    f->carry_len = 0;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+// Доступ к куску для внешнего разбора (например, line_validate.h): если
+// lf_has_carry() == 0, неразобранный остаток начинается с начала строки,
+// его можно разобрать самому и сдвинуть позицию через lf_skip().
+static inline int lf_has_carry(const line_framer_t *f)
+{
+    return f->carry_len > 0;
+}
+
+static inline const char *lf_rest(const line_framer_t *f, size_t *len)
+{
+    *len = f->chunk_len - f->pos;
+    return f->chunk + f->pos;
+}
+
+static inline void lf_skip(line_framer_t *f, size_t n)
+{
+    f->pos += n;
+}
+
+//------------------------------------------------------------------------------
+// Конец потока: 1 — отдана последняя строка без '\n', 0 — хвоста нет
+static inline int lf_finish(line_framer_t *f, const char **line, size_t *len)
+{
+    if (f->carry_len == 0) {
+        return 0;
+    }
+    if (lf_carry_append(f, "\n", 1) < 0) {
+        return -1;
+    }
+    *line = f->carry;
+    *len = f->carry_len;
+    f->carry_len = 0;
+    return 1;
+}
+
+#endif // OSI_LINE_FRAMER_H
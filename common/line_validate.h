@@ -0,0 +1,222 @@
+#ifndef OSI_LINE_VALIDATE_H
+#define OSI_LINE_VALIDATE_H
+
+// ----------------------------------------------
+// Проверка окончаний строк за один проход по буферу.
+//
+// Строка принимается, если символ перед '\n' — ';' или '.'. Ядро находит все
+// '\n' в буфере и для каждой строки записывает смещение её '\n' в ends[]
+// и бит вердикта в ok_bits[] (бит i — строка i принята). Строки ищутся
+// блоками по 64 байта (4 регистра SSE2 или 2 AVX2): маска переводов строки и маска
+// терминаторов, сдвинутая на один байт, дают вердикт без повторного чтения.
+// Вариант выбирается по CPUID при первом вызове, без SIMD — memchr().
+//
+// prev — байт, стоящий перед buf (последний байт предыдущего куска или
+// '\n', если buf начинается со строки). Пустая строка всегда отклоняется,
+// отличить её можно по соседним ends[].
+// ----------------------------------------------
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LV_HAVE_X86 1
+#endif
+
+typedef size_t (*lv_scan_fn)(const char *buf, size_t len, char prev,
+                             uint32_t *ends, uint64_t *ok_bits, size_t max_lines,
+                             size_t *consumed);
+
+//------------------------------------------------------------------------------
+static inline int lv_is_term(char c)
+{
+    return c == ';' || c == '.';
+}
+
+static inline int lv_line_ok(const uint64_t *ok_bits, size_t i)
+{
+    return (int)((ok_bits[i >> 6] >> (i & 63)) & 1);
+}
+
+static inline void lv_emit(uint32_t *ends, uint64_t *ok_bits, size_t n, size_t pos, uint64_t ok)
+{
+    if ((n & 63) == 0) {
+        ok_bits[n >> 6] = 0;
+    }
+    ends[n] = (uint32_t)pos;
+    ok_bits[n >> 6] |= ok << (n & 63);
+}
+
+//------------------------------------------------------------------------------
+// Скалярный вариант: переводы строки ищет memchr() из libc.
+// Возвращает число найденных строк (не больше max_lines); *consumed — сколько
+// байт разобрано (до последнего '\n' включительно, если упёрлись в max_lines).
+static size_t lv_scan_scalar(const char *buf, size_t len, char prev,
+                             uint32_t *ends, uint64_t *ok_bits, size_t max_lines,
+                             size_t *consumed)
+{
+    size_t n = 0;
+    size_t pos = 0;
+
+    while (n < max_lines && pos < len) {
+        const char *nl = memchr(buf + pos, '\n', len - pos);
+        if (!nl) {
+            pos = len;
+            break;
+        }
+        size_t at = (size_t)(nl - buf);
+        char before = at > 0 ? buf[at - 1] : prev;
+        lv_emit(ends, ok_bits, n++, at, (uint64_t)lv_is_term(before));
+        pos = at + 1;
+    }
+
+    *consumed = pos;
+    return n;
+}
+
+#ifdef LV_HAVE_X86
+//------------------------------------------------------------------------------
+// Хвост короче блока векторные варианты дочищают побайтно
+static inline size_t lv_scan_tail(const char *buf, size_t i, size_t len, char prev,
+                                  uint32_t *ends, uint64_t *ok_bits, size_t n, size_t max_lines,
+                                  size_t *consumed)
+{
+    for (; i < len; i++) {
+        if (buf[i] == '\n') {
+            char before = i > 0 ? buf[i - 1] : prev;
+            lv_emit(ends, ok_bits, n++, i, (uint64_t)lv_is_term(before));
+            if (n == max_lines) {
+                *consumed = i + 1;
+                return n;
+            }
+        }
+    }
+    *consumed = len;
+    return n;
+}
+
+// Общая часть векторных вариантов: разбор масок одного блока.
+// nl — биты '\n', before — биты "предыдущий байт — терминатор".
+#define LV_DRAIN_BLOCK(base)                                                   \
+    while (nl) {                                                               \
+        unsigned bit = (unsigned)__builtin_ctzll(nl);                          \
+        lv_emit(ends, ok_bits, n++, (base) + bit, (before >> bit) & 1);        \
+        nl &= nl - 1;                                                          \
+        if (n == max_lines) {                                                  \
+            *consumed = (base) + bit + 1;                                      \
+            return n;                                                          \
+        }                                                                      \
+    }
+
+__attribute__((target("sse2")))
+static size_t lv_scan_sse2(const char *buf, size_t len, char prev,
+                           uint32_t *ends, uint64_t *ok_bits, size_t max_lines,
+                           size_t *consumed)
+{
+    const __m128i v_nl = _mm_set1_epi8('\n');
+    const __m128i v_semi = _mm_set1_epi8(';');
+    const __m128i v_dot = _mm_set1_epi8('.');
+    uint64_t carry = (uint64_t)lv_is_term(prev);
+    size_t n = 0;
+    size_t i = 0;
+
+    if (max_lines == 0) {
+        *consumed = 0;
+        return 0;
+    }
+
+    // Блок 64 байта = 4 регистра, маски склеиваются в одно 64-битное слово
+    for (; i + 64 <= len; i += 64) {
+        __m128i v[4];
+        uint64_t nl = 0;
+        for (int k = 0; k < 4; k++) {
+            v[k] = _mm_loadu_si128((const __m128i *)(buf + i + 16 * k));
+            nl |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v[k], v_nl)) << (16 * k);
+        }
+        if (nl) {
+            // Маску терминаторов считаем только там, где есть концы строк
+            uint64_t t = 0;
+            for (int k = 0; k < 4; k++) {
+                __m128i term = _mm_or_si128(_mm_cmpeq_epi8(v[k], v_semi), _mm_cmpeq_epi8(v[k], v_dot));
+                t |= (uint64_t)(uint32_t)_mm_movemask_epi8(term) << (16 * k);
+            }
+            uint64_t before = (t << 1) | carry;
+            LV_DRAIN_BLOCK(i);
+        }
+        carry = (uint64_t)lv_is_term(buf[i + 63]);
+    }
+
+    return lv_scan_tail(buf, i, len, prev, ends, ok_bits, n, max_lines, consumed);
+}
+
+__attribute__((target("avx2")))
+static size_t lv_scan_avx2(const char *buf, size_t len, char prev,
+                           uint32_t *ends, uint64_t *ok_bits, size_t max_lines,
+                           size_t *consumed)
+{
+    const __m256i v_nl = _mm256_set1_epi8('\n');
+    const __m256i v_semi = _mm256_set1_epi8(';');
+    const __m256i v_dot = _mm256_set1_epi8('.');
+    uint64_t carry = (uint64_t)lv_is_term(prev);
+    size_t n = 0;
+    size_t i = 0;
+
+    if (max_lines == 0) {
+        *consumed = 0;
+        return 0;
+    }
+
+    // Блок 64 байта = 2 регистра, маски склеиваются в одно 64-битное слово
+    for (; i + 64 <= len; i += 64) {
+        __m256i lo = _mm256_loadu_si256((const __m256i *)(buf + i));
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(buf + i + 32));
+        uint64_t nl = (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, v_nl))
+                    | (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, v_nl)) << 32;
+        if (nl) {
+            // Маску терминаторов считаем только там, где есть концы строк
+            __m256i t_lo = _mm256_or_si256(_mm256_cmpeq_epi8(lo, v_semi), _mm256_cmpeq_epi8(lo, v_dot));
+            __m256i t_hi = _mm256_or_si256(_mm256_cmpeq_epi8(hi, v_semi), _mm256_cmpeq_epi8(hi, v_dot));
+            uint64_t t = (uint64_t)(uint32_t)_mm256_movemask_epi8(t_lo)
+                       | (uint64_t)(uint32_t)_mm256_movemask_epi8(t_hi) << 32;
+            uint64_t before = (t << 1) | carry;
+            LV_DRAIN_BLOCK(i);
+        }
+        carry = (uint64_t)lv_is_term(buf[i + 63]);
+    }
+
+    return lv_scan_tail(buf, i, len, prev, ends, ok_bits, n, max_lines, consumed);
+}
+
+#undef LV_DRAIN_BLOCK
+#endif // LV_HAVE_X86
+
+//------------------------------------------------------------------------------
+// Выбор варианта под текущий процессор (один раз на процесс)
+static inline lv_scan_fn lv_select(void)
+{
+#ifdef LV_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return lv_scan_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return lv_scan_sse2;
+    }
+#endif
+    return lv_scan_scalar;
+}
+
+static inline size_t lv_scan(const char *buf, size_t len, char prev,
+                             uint32_t *ends, uint64_t *ok_bits, size_t max_lines,
+                             size_t *consumed)
+{
+    static lv_scan_fn impl = NULL;
+    if (!impl) {
+        impl = lv_select();
+    }
+    return impl(buf, len, prev, ends, ok_bits, max_lines, consumed);
+}
+
+#endif // OSI_LINE_VALIDATE_H
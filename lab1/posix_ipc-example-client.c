@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
@@ -5,11 +6,367 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <errno.h>
+#include <poll.h>
 
+#include "../common/batch_writer.h"
+#include "../common/line_framer.h"
+#include "../common/line_validate.h"
+
+// NOTE: One read() may hold many lines or a part of one, lines are cut
+//       out of it by the framer, see line_framer.h
+#define READ_CHUNK (1 << 16)
+// NOTE: Lines validated per lv_scan() call
+#define SCAN_BATCH 1024
+
+// NOTE: Zero-copy mode (SPLICE_PIPELINE=1, set by the parent's environment).
+//       Line bytes never pass through user space on their way to the file:
+//       tee() duplicates what is in the input pipe into a private peek pipe,
+//       only that duplicate is read (for validation), and then the accepted
+//       bytes are moved from stdin to the file with splice(). Rejected ones
+//       are spliced into /dev/null. An incomplete line at the end of a window
+//       is parked in a hold pipe, so tee() blocks until new data arrives.
+//       A line that outgrows the hold pipe is copied through user memory
+//       instead and written with write() once its '\n' arrives.
+#define PEEK_WINDOW (1 << 20)
+
+typedef struct {
+    int file;
+    int devnull;
+    int peek[2];        // NOTE: tee() target, read back for validation
+    int hold[2];        // NOTE: incomplete line waiting for its '\n'
+    size_t hold_len;
+    size_t hold_cap;    // NOTE: real hold pipe capacity, F_SETPIPE_SZ may be refused
+    char hold_last;     // NOTE: last byte of the held part
+    char hold_text[256];
+    size_t hold_text_len;
+    bool copying;       // NOTE: line longer than the hold pipe, collecting it in `copy`
+    char *copy;
+    size_t copy_len;
+    size_t copy_cap;
+} splice_state_t;
+
+static char window[PEEK_WINDOW];
+
+static int splice_all(int in, int out, size_t len) {
+    while (len > 0) {
+        ssize_t n = splice(in, NULL, out, NULL, len, SPLICE_F_MOVE);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        len -= n;
+    }
+    return 0;
+}
+
+static void report_line(const char *held, size_t held_len, const char *line, size_t len) {
+    char msg[4096];
+    int n = snprintf(msg, sizeof(msg), "child error: string does not end with ; or . Error string: %.*s%.*s",
+                     (int)held_len, held, (int)len, line);
+    if (n > (int)sizeof(msg) - 1) {
+        n = sizeof(msg) - 1;
+    }
+    write(STDERR_FILENO, msg, n);
+}
+
+// NOTE: Move the held part of a line to the file or drop it
+static int release_hold(splice_state_t *st, bool accept) {
+    int rc = 0;
+    if (st->hold_len > 0) {
+        rc = splice_all(st->hold[0], accept ? st->file : st->devnull, st->hold_len);
+    }
+    st->hold_len = 0;
+    st->hold_text_len = 0;
+    return rc;
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int copy_reserve(splice_state_t *st, size_t len) {
+    if (st->copy_len + len <= st->copy_cap) {
+        return 0;
+    }
+    size_t cap = st->copy_cap ? st->copy_cap : PEEK_WINDOW;
+    while (cap < st->copy_len + len) {
+        cap *= 2;
+    }
+    char *copy = realloc(st->copy, cap);
+    if (!copy) {
+        return -1;
+    }
+    st->copy = copy;
+    st->copy_cap = cap;
+    return 0;
+}
+
+// NOTE: Add bytes of the copied line; they are also consumed from stdin,
+//       their duplicate in `window` is what gets stored
+static int copy_append(splice_state_t *st, const char *data, size_t len) {
+    if (copy_reserve(st, len) == -1 || splice_all(STDIN_FILENO, st->devnull, len) == -1) {
+        return -1;
+    }
+    memcpy(st->copy + st->copy_len, data, len);
+    st->copy_len += len;
+    return 0;
+}
+
+// NOTE: The line outgrew the hold pipe: read what is held so far into `copy`
+static int start_copy(splice_state_t *st) {
+    st->copying = true;
+    st->copy_len = 0;
+    if (copy_reserve(st, st->hold_len) == -1) {
+        return -1;
+    }
+    while (st->hold_len > 0) {
+        ssize_t r = read(st->hold[0], st->copy + st->copy_len, st->hold_len);
+        if (r == -1 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            return -1;
+        }
+        st->copy_len += r;
+        st->hold_len -= r;
+    }
+    st->hold_text_len = 0;
+    return 0;
+}
+
+// NOTE: The copied line is complete (ends with '\n'), check and write it
+static int finish_copy(splice_state_t *st) {
+    size_t len = st->copy_len;
+    char last = len >= 2 ? st->copy[len - 2] : '\n';
+    bool ok = last == ';' || last == '.';
+    st->copying = false;
+    st->copy_len = 0;
+    if (!ok) {
+        report_line(st->copy, len, "", 0);
+        return 0;
+    }
+    return write_all(st->file, st->copy, len);
+}
+
+// NOTE: Returns 0 on success, -1 on I/O failure
+static int run_splice_pipeline(splice_state_t *st) {
+    // NOTE: Only EOF ends the input: the parent closes the pipe when the user
+    //       is done, an empty line is just a line without ';' or '.'
+    while (true) {
+        ssize_t n = tee(STDIN_FILENO, st->peek[1], PEEK_WINDOW, 0);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1) {
+            return -1;
+        }
+        if (n == 0) {
+            break; // NOTE: Writer closed the pipe and it is drained
+        }
+
+        for (ssize_t got = 0; got < n;) {
+            ssize_t r = read(st->peek[0], window + got, n - got);
+            if (r <= 0) {
+                return -1;
+            }
+            got += r;
+        }
+
+        // NOTE: Consecutive lines with the same verdict go in one splice
+        size_t pos = 0;
+        size_t run_len = 0;
+        bool run_ok = true;
+        while (pos < (size_t)n) {
+            char *line = window + pos;
+            char *nl = memchr(line, '\n', n - pos);
+            if (!nl) {
+                break;
+            }
+            size_t len = nl - line + 1;
+
+            if (st->copying) {
+                if (copy_append(st, line, len) == -1 || finish_copy(st) == -1) {
+                    return -1;
+                }
+                pos += len;
+                continue;
+            }
+
+            char last = len >= 2 ? line[len - 2] : st->hold_len > 0 ? st->hold_last : '\n';
+            bool ok = last == ';' || last == '.';
+            if (!ok) {
+                report_line(st->hold_text, st->hold_text_len, line, len);
+            }
+
+            if (st->hold_len > 0 || (run_len > 0 && ok != run_ok)) {
+                if (run_len > 0 && splice_all(STDIN_FILENO, run_ok ? st->file : st->devnull, run_len) == -1) {
+                    return -1;
+                }
+                run_len = 0;
+                if (release_hold(st, ok) == -1) {
+                    return -1;
+                }
+            }
+            run_ok = ok;
+            run_len += len;
+            pos += len;
+        }
+
+        if (run_len > 0 && splice_all(STDIN_FILENO, run_ok ? st->file : st->devnull, run_len) == -1) {
+            return -1;
+        }
+        // NOTE: Park the incomplete tail so the input pipe is drained
+        size_t tail = n - pos;
+        if (tail > 0) {
+            if (st->copying || st->hold_len + tail > st->hold_cap) {
+                if (!st->copying && start_copy(st) == -1) {
+                    return -1;
+                }
+                if (copy_append(st, window + pos, tail) == -1) {
+                    return -1;
+                }
+            } else {
+                if (splice_all(STDIN_FILENO, st->hold[1], tail) == -1) {
+                    return -1;
+                }
+                size_t room = sizeof(st->hold_text) - st->hold_text_len;
+                size_t keep = tail < room ? tail : room;
+                memcpy(st->hold_text + st->hold_text_len, window + pos, keep);
+                st->hold_text_len += keep;
+                st->hold_last = window[n - 1];
+                st->hold_len += tail;
+            }
+        }
+    }
+
+    // NOTE: Last line without '\n' at EOF
+    if (st->copying) {
+        if (copy_reserve(st, 1) == -1) {
+            return -1;
+        }
+        st->copy[st->copy_len++] = '\n';
+        return finish_copy(st);
+    }
+    if (st->hold_len > 0) {
+        bool ok = st->hold_last == ';' || st->hold_last == '.';
+        if (!ok) {
+            report_line(st->hold_text, st->hold_text_len, "\n", 1);
+        }
+        if (release_hold(st, ok) == -1) {
+            return -1;
+        }
+        if (ok && write(st->file, "\n", 1) != 1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int start_splice_pipeline(int file) {
+    splice_state_t st = {.file = file};
+
+    // NOTE: splice() refuses O_APPEND outputs; the file was just truncated
+    //       and we are its only writer, so plain writes land in the same place
+    fcntl(file, F_SETFL, fcntl(file, F_GETFL) & ~O_APPEND);
+
+    st.devnull = open("/dev/null", O_WRONLY);
+    if (st.devnull == -1 || pipe(st.peek) == -1 || pipe(st.hold) == -1) {
+        return -1;
+    }
+    fcntl(st.peek[1], F_SETPIPE_SZ, PEEK_WINDOW);
+    fcntl(st.hold[1], F_SETPIPE_SZ, PEEK_WINDOW);
+    st.hold_cap = fcntl(st.hold[1], F_GETPIPE_SZ);
+
+    int rc = run_splice_pipeline(&st);
+
+    close(st.devnull);
+    close(st.peek[0]);
+    close(st.peek[1]);
+    close(st.hold[0]);
+    close(st.hold[1]);
+    free(st.copy);
+    return rc;
+}
+
+
+// NOTE: Validate one complete line (with its '\n') and pass it to the writer.
+//       Returns 1 to go on, -1 on error. Only EOF ends the input: the parent
+//       closes the pipe when the user is done, so an empty line is just
+//       a line without ';' or '.'
+static int handle_line(batch_writer_t *writer, const char *line, size_t len) {
+    if (len == 1 || (line[len - 2] != ';' && line[len - 2] != '.')) {
+        report_line(NULL, 0, line, len);
+        return 1;
+    }
+    return bw_append(writer, line, len) == -1 ? -1 : 1;
+}
+
+// NOTE: Same for `count` lines found by lv_scan() in `data`. Consecutive
+//       accepted lines are contiguous there and go to the writer in one piece.
+static int handle_lines(batch_writer_t *writer, const char *data, size_t count,
+                        const uint32_t *ends, const uint64_t *ok_bits) {
+    size_t start = 0;
+    size_t run_start = 0;
+    int rc = 1;
+    for (size_t i = 0; i < count; i++) {
+        size_t end = ends[i] + 1;
+        bool ok = lv_line_ok(ok_bits, i);
+        if (!ok) {
+            if (start > run_start) {
+                // NOTE: Flush the accepted run that ends before this line
+                if (bw_append(writer, data + run_start, start - run_start) == -1) {
+                    return -1;
+                }
+            }
+            report_line(NULL, 0, data + start, end - start);
+            run_start = end;
+        }
+        start = end;
+    }
+    if (start > run_start && bw_append(writer, data + run_start, start - run_start) == -1) {
+        rc = -1;
+    }
+    return rc;
+}
+
+// NOTE: WRITER_FLUSH_MS is checked only when a line is appended, so before
+//       blocking in read() wait for input no longer than the batch is due
+//       and flush it if nothing came. Returns 0, or -1 on a write error.
+static int flush_while_idle(batch_writer_t *writer) {
+    long ms;
+    while ((ms = bw_due_ms(writer)) >= 0) {
+        struct pollfd pfd = {.fd = STDIN_FILENO, .events = POLLIN};
+        int ready = poll(&pfd, 1, (int)ms);
+        if (ready == -1 && errno == EINTR) {
+            continue;
+        }
+        if (ready != 0) {
+            return 0; // NOTE: Input (or EOF) is there, read() won't block
+        }
+        if (bw_flush_if_due(writer) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
 
 
 int main(int argc, char **argv) {
-    char buf[4096];
+    static char buf[READ_CHUNK];
     ssize_t bytes;
 
 
@@ -24,47 +381,94 @@ int main(int argc, char **argv) {
         exit(EXIT_FAILURE);
     }
 
-
-    while ((bytes = read(STDIN_FILENO, buf, sizeof(buf)))) {
-        int8_t f = 1;
-        if (bytes < 0) {
-            const char msg[] = "error: failed to read from stdin\n";
+    const char *splice_env = getenv("SPLICE_PIPELINE");
+    if (splice_env && strcmp(splice_env, "1") == 0) {
+        if (start_splice_pipeline(file) == -1) {
+            const char msg[] = "error: zero-copy pipeline failed\n";
             write(STDERR_FILENO, msg, sizeof(msg));
             exit(EXIT_FAILURE);
-        } else if (buf[0] == '\n') {
-            // NOTE: When Enter is pressed with no input, then exit client
-            break;
         }
+        close(file);
+        return 0;
+    }
 
+    // NOTE: Accepted lines are batched and flushed with writev, see batch_writer.h
+    batch_writer_t writer;
+    if (bw_init(&writer, file) == -1) {
+        const char msg[] = "error: failed to allocate output buffer\n";
+        write(STDERR_FILENO, msg, sizeof(msg));
+        exit(EXIT_FAILURE);
+    }
 
-        {
-            if (buf[bytes - 2] != ';' && buf[bytes - 2] != '.'){
-
-                char msg[4096];
-                int len = snprintf(msg, sizeof(msg), "child error: string does not end with ; or . Error string: %s", buf);
-
-                write(STDERR_FILENO, msg, len);
-                f = 0;
+    line_framer_t framer;
+    lf_init(&framer);
 
+    const char *line;
+    size_t len;
+    int rc = 1;
+    while (rc == 1) {
+        if (flush_while_idle(&writer) == -1) {
+            rc = -1;
+            break;
+        }
+        bytes = read(STDIN_FILENO, buf, sizeof(buf));
+        if (bytes == 0) {
+            break;
+        }
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
             }
+            const char msg[] = "error: failed to read from stdin\n";
+            write(STDERR_FILENO, msg, sizeof(msg));
+            exit(EXIT_FAILURE);
         }
 
-        {
-            // NOTE: Replace newline with NULL-terminator
-            buf[bytes - 1] = '\n';
-            if (f != 0) {
-                int32_t written = write(file, buf, bytes);
-                if (written != bytes) {
-                    const char msg[] = "error: failed to write to file\n";
-                    write(STDERR_FILENO, msg, sizeof(msg));
-                    exit(EXIT_FAILURE);
-                }
-            }
-            memset(buf, 0,sizeof(buf));
+        // NOTE: Every complete line of the chunk is handled, the incomplete
+        //       tail waits in the framer for the next read
+        lf_begin(&framer, buf, bytes);
+        int got = 0;
+        if (lf_has_carry(&framer) && (got = lf_next(&framer, &line, &len)) == 1) {
+            // NOTE: The line started in the previous chunk
+            rc = handle_line(&writer, line, len);
         }
 
+        // NOTE: The rest starts at a line boundary, validate it in batches
+        while (rc == 1 && got != -1) {
+            static uint32_t ends[SCAN_BATCH];
+            static uint64_t ok_bits[SCAN_BATCH / 64];
+            size_t rest_len;
+            size_t consumed;
+            const char *rest = lf_rest(&framer, &rest_len);
+            size_t count = lv_scan(rest, rest_len, '\n', ends, ok_bits, SCAN_BATCH, &consumed);
+            if (count == 0) {
+                // NOTE: Only an incomplete line is left, the framer keeps it
+                got = lf_next(&framer, &line, &len);
+                break;
+            }
+            rc = handle_lines(&writer, rest, count, ends, ok_bits);
+            lf_skip(&framer, ends[count - 1] + 1);
+        }
+        if (got == -1) {
+            rc = -1;
+        }
     }
 
+    // NOTE: Last line had no '\n' before EOF
+    if (rc == 1) {
+        int got = lf_finish(&framer, &line, &len);
+        if (got == 1) {
+            rc = handle_line(&writer, line, len);
+        } else if (got == -1) {
+            rc = -1;
+        }
+    }
+    lf_destroy(&framer);
 
+    if (rc == -1 || bw_close(&writer) == -1) {
+        const char msg[] = "error: failed to write to file\n";
+        write(STDERR_FILENO, msg, sizeof(msg));
+        exit(EXIT_FAILURE);
+    }
     close(file);
 }
\ No newline at end of file
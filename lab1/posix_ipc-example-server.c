@@ -1,20 +1,278 @@
+#define _GNU_SOURCE
 #include <stdint.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
 static char CLIENT_PROGRAM_NAME[] = "posix_ipc-example-client";
 
+// NOTE: Pipe capacity requested for the data channel, fewer wakeups per MB
+#define DATA_PIPE_SIZE (1 << 20)
+// NOTE: Max bytes moved by one splice() call
+#define SPLICE_CHUNK (1 << 16)
+
+
+// NOTE: Filename is read with plain read() byte by byte: stdio would buffer
+//       input past the first line, and those bytes must stay in the fd
+//       for the data loop (and for splice in zero-copy mode)
+static int read_filename(char *file, size_t size) {
+    size_t len = 0;
+    char ch;
+    while (read(STDIN_FILENO, &ch, 1) == 1 && ch != '\n') {
+        if (ch == ' ' || ch == '\t') {
+            if (len > 0) {
+                // NOTE: Only the first word is a filename, skip the rest of line
+                while (read(STDIN_FILENO, &ch, 1) == 1 && ch != '\n') {
+                }
+                break;
+            }
+            continue;
+        }
+        if (len < size - 1) {
+            file[len++] = ch;
+        }
+    }
+    file[len] = '\0';
+    return (int)len;
+}
+
+// NOTE: Print everything the child has reported so far. On a non-blocking
+//       pipe returns once it is empty, on a blocking one reads until EOF.
+//       Returns false once the child has closed its end.
+static bool forward_child_errors(int fd, pid_t pid, pid_t child) {
+    char buf[4096];
+    ssize_t error_bytes;
+    bool header = false;
+    while ((error_bytes = read(fd, buf, sizeof(buf))) > 0) {
+        if (!header) {
+            char msg[64];
+            int32_t length = snprintf(msg, sizeof(msg), "%d: I'm a parent, my child has PID %d\n", pid, child);
+            write(STDOUT_FILENO, msg, length);
+            header = true;
+        }
+
+        write(STDOUT_FILENO, buf, error_bytes); // Выводим только реальное количество считанных байт
+    }
+    return error_bytes == -1 && (errno == EAGAIN || errno == EINTR);
+}
+
+// NOTE: State of the parent event loop. Input moves stdin -> data pipe one
+//       chunk at a time: stdin is not read again until the pending chunk is
+//       fully written, so a slow child throttles the parent instead of
+//       making it buffer. Readiness flags are cleared on EAGAIN and set
+//       again by epoll.
+typedef struct {
+    int epfd;
+    int data_fd;
+    int err_fd;
+    bool zero_copy;
+    bool interactive;      // stdin is a terminal, an empty line ends input
+    bool spliced;          // at least one splice() succeeded
+    bool stdin_polled;     // false for a regular file: epoll refuses it, reads never block
+    bool stdin_ready;
+    bool data_ready;
+    uint32_t stdin_events; // currently armed epoll masks
+    uint32_t data_events;
+    char *buf;
+    size_t buf_size;
+    size_t pend_off;
+    size_t pend_len;
+} event_loop_t;
+
+static void arm(event_loop_t *loop, int fd, uint32_t *current, uint32_t events) {
+    if (*current != events) {
+        struct epoll_event ev = {.events = events, .data.fd = fd};
+        epoll_ctl(loop->epfd, EPOLL_CTL_MOD, fd, &ev);
+        *current = events;
+    }
+}
+
+static void fail(const char *msg) {
+    write(STDERR_FILENO, msg, strlen(msg));
+    exit(EXIT_FAILURE);
+}
+
+// NOTE: Move at most one chunk of input. Returns 1 when input is over
+//       (EOF, an empty line typed on a terminal, or EPIPE: the child has
+//       exited and nobody reads the rest), 0 otherwise.
+//       SIGPIPE is ignored, so a dead child shows up here as EPIPE.
+static int pump_input(event_loop_t *loop) {
+    if (loop->zero_copy) {
+        // NOTE: Zero-copy: pages move from stdin into the pipe without passing
+        //       through buf. EINVAL on the first call means stdin does not
+        //       support splice, then fall back to read/write.
+        ssize_t moved = splice(STDIN_FILENO, NULL, loop->data_fd, NULL, SPLICE_CHUNK,
+                               SPLICE_F_MOVE | SPLICE_F_MORE | SPLICE_F_NONBLOCK);
+        if (moved == -1 && errno == EAGAIN) {
+            // NOTE: Wait only for the side that blocked: if stdin still has
+            //       bytes, the data pipe is the one that is full
+            int avail = 0;
+            if (loop->stdin_polled && (ioctl(STDIN_FILENO, FIONREAD, &avail) == -1 || avail == 0)) {
+                loop->stdin_ready = false;
+            } else {
+                loop->data_ready = false;
+            }
+            return 0;
+        }
+        if (moved == -1 && errno == EINVAL && !loop->spliced) {
+            loop->zero_copy = false;
+            return 0;
+        }
+        if (moved == -1 && errno == EPIPE) {
+            return 1;
+        }
+        if (moved == -1 && errno != EINTR) {
+            fail("error: failed to splice stdin to channel_data\n");
+        }
+        if (moved == 0) {
+            return 1;
+        }
+        loop->spliced = loop->spliced || moved > 0;
+        return 0;
+    }
+
+    if (loop->pend_off < loop->pend_len) {
+        ssize_t written = write(loop->data_fd, loop->buf + loop->pend_off, loop->pend_len - loop->pend_off);
+        if (written == -1 && errno == EAGAIN) {
+            loop->data_ready = false;
+        } else if (written == -1 && errno == EPIPE) {
+            return 1; // NOTE: Child has finished, nobody reads the rest
+        } else if (written == -1 && errno != EINTR) {
+            fail("error: failed to write to channel_data\n");
+        } else if (written > 0) {
+            loop->pend_off += (size_t)written;
+        }
+        return 0;
+    }
+
+    ssize_t bytes = read(STDIN_FILENO, loop->buf, loop->buf_size);
+    if (bytes == -1 && (errno == EAGAIN || errno == EINTR)) {
+        loop->stdin_ready = !loop->stdin_polled;
+        return 0;
+    }
+    if (bytes < 0) {
+        fail("error: failed to read from stdin\n");
+    }
+    // NOTE: A terminal returns one line per read, so an empty line there
+    //       is a lone '\n'. From a file or pipe read() boundaries mean
+    //       nothing, only EOF ends input, same as in the child.
+    if (bytes == 0 || (loop->interactive && bytes == 1 && loop->buf[0] == '\n')) {
+        return 1; // Выход, если введена пустая строка или EOF
+    }
+    // NOTE: One read per readiness event: a second read on a terminal could block
+    loop->stdin_ready = !loop->stdin_polled;
+    loop->pend_off = 0;
+    loop->pend_len = (size_t)bytes;
+    return 0;
+}
+
+// NOTE: Whether pump_input() can make progress without waiting
+static bool input_runnable(const event_loop_t *loop) {
+    if (loop->zero_copy) {
+        return loop->data_ready && loop->stdin_ready;
+    }
+    return loop->pend_off < loop->pend_len ? loop->data_ready : loop->stdin_ready;
+}
+
+// NOTE: Parent main loop over stdin, the data pipe and the error pipe.
+//       Child errors are printed as soon as they arrive, independent of
+//       whether the user is typing. Returns after input is over and the
+//       child has closed the error pipe.
+static void run_event_loop(int data_fd, int err_fd, pid_t pid, pid_t child, bool zero_copy) {
+    static char buf[1 << 16];
+    event_loop_t loop = {
+        .data_fd = data_fd,
+        .err_fd = err_fd,
+        .zero_copy = zero_copy,
+        .interactive = isatty(STDIN_FILENO),
+        .data_ready = true,
+        .buf = buf,
+        .buf_size = sizeof(buf),
+    };
+
+    loop.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop.epfd == -1) {
+        fail("error: failed to create epoll instance\n");
+    }
+    fcntl(data_fd, F_SETFL, O_NONBLOCK);
+    fcntl(err_fd, F_SETFL, O_NONBLOCK);
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = err_fd};
+    epoll_ctl(loop.epfd, EPOLL_CTL_ADD, err_fd, &ev);
+    ev = (struct epoll_event){.events = 0, .data.fd = data_fd};
+    epoll_ctl(loop.epfd, EPOLL_CTL_ADD, data_fd, &ev);
+    // NOTE: stdin stays blocking (it may be the shared terminal), it is only
+    //       read after epoll reported it readable
+    ev = (struct epoll_event){.events = 0, .data.fd = STDIN_FILENO};
+    loop.stdin_polled = epoll_ctl(loop.epfd, EPOLL_CTL_ADD, STDIN_FILENO, &ev) == 0;
+    loop.stdin_ready = !loop.stdin_polled;
+
+    bool input_open = true;
+    bool errors_open = true;
+    while (input_open || errors_open) {
+        if (input_open && input_runnable(&loop) && pump_input(&loop) == 1) {
+            // NOTE: EOF for the child, it finishes and closes the error pipe
+            input_open = false;
+            epoll_ctl(loop.epfd, EPOLL_CTL_DEL, data_fd, NULL);
+            close(data_fd);
+            if (loop.stdin_polled) {
+                epoll_ctl(loop.epfd, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+            }
+            if (!errors_open) {
+                break; // NOTE: Child exited before input was over, nothing left to wait for
+            }
+        }
+
+        if (input_open) {
+            // NOTE: Copy mode waits either for the pipe (chunk pending) or for
+            //       stdin, never both; zero-copy waits for whichever blocked
+            bool pending = loop.zero_copy || loop.pend_off < loop.pend_len;
+            bool want_stdin = loop.zero_copy || !pending;
+            arm(&loop, data_fd, &loop.data_events, pending && !loop.data_ready ? EPOLLOUT : 0);
+            if (loop.stdin_polled) {
+                arm(&loop, STDIN_FILENO, &loop.stdin_events, want_stdin && !loop.stdin_ready ? EPOLLIN : 0);
+            }
+        }
+
+        // NOTE: Don't sleep while input can still move, just collect events
+        struct epoll_event events[4];
+        int timeout = input_open && input_runnable(&loop) ? 0 : -1;
+        int count = epoll_wait(loop.epfd, events, 4, timeout);
+        if (count == -1 && errno != EINTR) {
+            fail("error: epoll_wait failed\n");
+        }
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == err_fd) {
+                if (!forward_child_errors(err_fd, pid, child)) {
+                    errors_open = false;
+                    epoll_ctl(loop.epfd, EPOLL_CTL_DEL, err_fd, NULL);
+                }
+            } else if (fd == data_fd) {
+                loop.data_ready = true;
+            } else if (fd == STDIN_FILENO) {
+                loop.stdin_ready = true;
+            }
+        }
+    }
+
+    close(loop.epfd);
+}
+
 
 int main() {
 
     char file[4096];
     write(STDIN_FILENO, "Enter filename: ", 16);
-    if (scanf("%s", file) <= 0){
+    if (read_filename(file, sizeof(file)) <= 0){
 
         char mssg[1024];
         uint32_t len = snprintf(mssg, sizeof(mssg) - 1, "Enter filename failed\n");
@@ -55,6 +313,15 @@ int main() {
         write(STDERR_FILENO, msg, sizeof(msg));
         exit(EXIT_FAILURE);
     }
+    // NOTE: Best effort, the default 64K pipes still work
+    fcntl(channel_data[1], F_SETPIPE_SZ, DATA_PIPE_SIZE);
+    fcntl(channel_errors[1], F_SETPIPE_SZ, DATA_PIPE_SIZE);
+
+    // NOTE: Zero-copy mode: stdin is spliced straight into the data pipe.
+    //       Only makes sense for a file or pipe on stdin, not for a terminal.
+    //       The child sees the same variable after exec and switches too.
+    const char *splice_env = getenv("SPLICE_PIPELINE");
+    bool zero_copy = splice_env && strcmp(splice_env, "1") == 0 && !isatty(STDIN_FILENO);
 
 
     // NOTE: Spawn a new process
@@ -107,10 +374,6 @@ int main() {
 
         default: { // NOTE: We're a parent, parent knows PID of child after fork
             pid_t pid = getpid(); // NOTE: Get parent PID
-            char buf1[4096];
-            char buf[4096];
-            ssize_t bytes;
-            ssize_t bytes1;
 
             close(channel_data[0]);
             close(channel_errors[1]);
@@ -130,52 +393,36 @@ int main() {
 
 
 
-            fcntl(channel_errors[0], F_SETFL, O_NONBLOCK); // Устанавливаем неблокирующий режим для channel_errors[0]
-
-            while ((bytes1 = read(STDIN_FILENO, buf1, sizeof(buf1))) ) {
-                // Читаем ошибки, если они есть
-                ssize_t error_bytes = read(channel_errors[0], buf, sizeof(buf));
-                if (error_bytes > 0) {
-                    char msg[64];
-                    int32_t length = snprintf(msg, sizeof(msg), "%d: I'm a parent, my child has PID %d\n", pid, child);
-                    write(STDOUT_FILENO, msg, length);
-
-                    write(STDOUT_FILENO, buf, error_bytes); // Выводим только реальное количество считанных байт
-                }
+            // NOTE: A child that exits early must not kill the parent with
+            //       SIGPIPE: the write fails with EPIPE instead, input is
+            //       over and the child is still reaped below. Set after
+            //       fork, an ignored signal would survive the child's exec.
+            signal(SIGPIPE, SIG_IGN);
 
+            run_event_loop(channel_data[1], channel_errors[0], pid, child, zero_copy);
+            close(channel_errors[0]);
 
-                if (bytes1 < 0){
-                    const char msg[] = "error: failed to read from stdin\n";
-                    write(STDERR_FILENO, msg, sizeof(msg));
-                    exit(EXIT_FAILURE);
-                }
-                if (buf1[0] == '\n') {
-                    break; // Выход, если введена пустая строка
-                }
-
-                // Отправляем строку клиенту
-                if (write(channel_data[1], buf1, bytes1) == -1) {
-                    const char msg[] = "error: failed to write to channel_data\n";
-                    write(STDERR_FILENO, msg, sizeof(msg));
+            // NOTE: `waitpid` blocks the parent until child exits
+            int child_status;
+            while (waitpid(child, &child_status, 0) == -1) {
+                if (errno != EINTR) {
+                    const char msg[] = "error: failed to wait for child\n";
+                    write(STDERR_FILENO, msg, sizeof(msg) - 1);
                     exit(EXIT_FAILURE);
                 }
-
-
             }
-
-            close(channel_data[1]);
-            close(channel_errors[0]);
-
-
-
-            // NOTE: `wait` blocks the parent until child exits
-            int child_status;
-            wait(&child_status);
             if (WIFEXITED(child_status) && WEXITSTATUS(child_status) != EXIT_SUCCESS) {
                 const char msg[] = "error: child exited with error\n";
                 write(STDERR_FILENO, msg, sizeof(msg) - 1);
                 exit(WEXITSTATUS(child_status));
             }
+            if (WIFSIGNALED(child_status)) {
+                char msg[64];
+                int32_t len = snprintf(msg, sizeof(msg), "error: child was killed by signal %d\n",
+                                       WTERMSIG(child_status));
+                write(STDERR_FILENO, msg, len);
+                exit(EXIT_FAILURE);
+            }
 
         } break;
     }
@@ -0,0 +1,195 @@
+#ifndef LAB2_AFFINITY_H
+#define LAB2_AFFINITY_H
+
+/*
+ * Привязка потоков к процессорам с учётом NUMA (--affinity).
+ *
+ * Топология берётся из sysfs: /sys/devices/system/node/nodeN/cpulist —
+ * какие процессоры у узла N. Если узлов в sysfs нет (нет NUMA или sysfs
+ * не смонтирован), считаем всё одним узлом 0. Учитываются только
+ * процессоры, на которых процессу вообще разрешено работать
+ * (sched_getaffinity — taskset, cgroups).
+ *
+ * Порядок раздачи процессоров потокам:
+ *     compact  — узел за узлом: сначала заполняем узел 0, потом 1, ...
+ *                (потоки ближе друг к другу, общий L3);
+ *     scatter  — по кругу по узлам: поток 0 на узел 0, 1 на узел 1, ...
+ *                (больше памяти и L3 на поток);
+ *     СПИСОК   — явные номера процессоров, например 0,2,4-7.
+ * Поток i получает процессор plan[i % длина плана].
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define AFFINITY_MAX_CPUS CPU_SETSIZE
+#define AFFINITY_MAX_NODES 64
+
+typedef struct {
+    int nodeOf[AFFINITY_MAX_CPUS];  // узел процессора, -1 — процессор недоступен
+    int nodeCount;                  // узлов (номер последнего + 1)
+} affinity_topology_t;
+
+/*
+ * Разбор списка процессоров в формате ядра: "0-3,8,10-11" (допускаются
+ * пробелы и перевод строки в конце). В out — не больше max номеров;
+ * возвращает их число или -1 при ошибке.
+ */
+static inline int affinity_parse_list(const char *s, int *out, int max) {
+    int count = 0;
+    while (*s && *s != '\n') {
+        char *end;
+        long first = strtol(s, &end, 10);
+        long last = first;
+        if (end == s || first < 0) {
+            return -1;
+        }
+        if (*end == '-') {
+            s = end + 1;
+            last = strtol(s, &end, 10);
+            if (end == s || last < first) {
+                return -1;
+            }
+        }
+        if (last >= AFFINITY_MAX_CPUS) {
+            return -1;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (count == max) {
+                return -1;
+            }
+            out[count++] = (int) cpu;
+        }
+        s = end;
+        if (*s == ',') {
+            s++;
+        } else if (*s && *s != '\n') {
+            return -1;
+        }
+    }
+    return count;
+}
+
+// Файл целиком в buf (не больше size - 1 байт); 0 — не прочитан
+static inline int affinity_read_file(const char *path, char *buf, size_t size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    ssize_t len = read(fd, buf, size - 1);
+    close(fd);
+    if (len <= 0) {
+        return 0;
+    }
+    buf[len] = '\0';
+    return 1;
+}
+
+static inline void affinity_topology(affinity_topology_t *t) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_SET(0, &allowed);
+    }
+
+    for (int cpu = 0; cpu < AFFINITY_MAX_CPUS; cpu++) {
+        t->nodeOf[cpu] = -1;
+    }
+    t->nodeCount = 0;
+
+    static int cpus[AFFINITY_MAX_CPUS];
+    char path[64] = "/sys/devices/system/node/node";
+    size_t prefix = strlen(path);
+    static char list[16384];
+    for (int node = 0; node < AFFINITY_MAX_NODES; node++) {
+        // path = ".../nodeN/cpulist" без stdio
+        char digits[8];
+        int len = 0;
+        int n = node;
+        do {
+            digits[len++] = (char) ('0' + n % 10);
+            n /= 10;
+        } while (n);
+        size_t pos = prefix;
+        while (len) {
+            path[pos++] = digits[--len];
+        }
+        memcpy(path + pos, "/cpulist", sizeof("/cpulist"));
+
+        if (!affinity_read_file(path, list, sizeof(list))) {
+            continue; // номера узлов бывают с пропусками
+        }
+        int count = affinity_parse_list(list, cpus, AFFINITY_MAX_CPUS);
+        for (int i = 0; i < count; i++) {
+            if (CPU_ISSET(cpus[i], &allowed)) {
+                t->nodeOf[cpus[i]] = node;
+                t->nodeCount = node + 1;
+            }
+        }
+    }
+
+    // sysfs без узлов — все доступные процессоры на узле 0
+    if (t->nodeCount == 0) {
+        for (int cpu = 0; cpu < AFFINITY_MAX_CPUS; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                t->nodeOf[cpu] = 0;
+            }
+        }
+        t->nodeCount = 1;
+    }
+}
+
+/*
+ * Порядок процессоров для режима mode (compact, scatter или список).
+ * Возвращает длину плана (> 0) или 0 — mode не разобран либо в списке
+ * процессор, недоступный процессу.
+ */
+static inline int affinity_plan(const affinity_topology_t *t, const char *mode, int *plan) {
+    int count = 0;
+
+    if (strcmp(mode, "compact") == 0) {
+        for (int node = 0; node < t->nodeCount; node++) {
+            for (int cpu = 0; cpu < AFFINITY_MAX_CPUS; cpu++) {
+                if (t->nodeOf[cpu] == node) {
+                    plan[count++] = cpu;
+                }
+            }
+        }
+        return count;
+    }
+
+    if (strcmp(mode, "scatter") == 0) {
+        // Берём по одному процессору с каждого узла по очереди
+        int next[AFFINITY_MAX_NODES] = {0};
+        int added = 1;
+        while (added) {
+            added = 0;
+            for (int node = 0; node < t->nodeCount; node++) {
+                while (next[node] < AFFINITY_MAX_CPUS && t->nodeOf[next[node]] != node) {
+                    next[node]++;
+                }
+                if (next[node] < AFFINITY_MAX_CPUS) {
+                    plan[count++] = next[node]++;
+                    added = 1;
+                }
+            }
+        }
+        return count;
+    }
+
+    count = affinity_parse_list(mode, plan, AFFINITY_MAX_CPUS);
+    for (int i = 0; i < count; i++) {
+        if (t->nodeOf[plan[i]] < 0) {
+            return 0;
+        }
+    }
+    return count > 0 ? count : 0;
+}
+
+#endif // LAB2_AFFINITY_H
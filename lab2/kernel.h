@@ -0,0 +1,213 @@
+#ifndef LAB2_KERNEL_H
+#define LAB2_KERNEL_H
+
+/*
+ * Ядро "сколько точек попало в круг" для одного блока точек.
+ *
+ * Блок генерирует точки из KERNEL_LANES независимых потоков xoshiro256+
+ * (поток lane блока block — rng_seed(seed, block * KERNEL_LANES + lane)):
+ * точка k берётся из потока k % KERNEL_LANES, сначала x, потом y. Так
+ * векторный вариант держит по потоку в каждой дорожке регистра и делает
+ * 8 точек за итерацию (AVX-512 — один регистр, AVX2 — два), а скалярный
+ * обходит те же потоки по очереди и даёт те же точки.
+ *
+ * Счёт идёт в единичных координатах: x, y в [-1, 1), попадание —
+ * x*x + y*y <= 1; масштаб R учитывается только в итоговой площади.
+ * Векторные варианты считают x*x + y*y через FMA, поэтому на самой границе
+ * круга (разница в последнем бите) вердикт может отличаться от скалярного.
+ *
+ * Вариант выбирается по CPUID один раз (kernel_select()).
+ */
+
+#include <stdint.h>
+
+#include "rng.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNEL_HAVE_X86 1
+#endif
+
+#define KERNEL_LANES 8
+#define KERNEL_BLOCK_POINTS (1L << 16)  // точек в блоке, см. BLOCK_POINTS в main.c
+
+typedef long (*kernel_fn)(uint64_t seed, uint64_t block, long points);
+
+typedef struct {
+    uint64_t s[4][KERNEL_LANES];   // слово i состояния потока lane — s[i][lane]
+} kernel_state_t;
+
+static inline void kernel_seed(kernel_state_t *st, uint64_t seed, uint64_t block) {
+    for (int lane = 0; lane < KERNEL_LANES; lane++) {
+        rng_t r;
+        rng_seed(&r, seed, block * KERNEL_LANES + (uint64_t) lane);
+        for (int i = 0; i < 4; i++) {
+            st->s[i][lane] = r.s[i];
+        }
+    }
+}
+
+static inline uint64_t kernel_next(kernel_state_t *st, int lane) {
+    rng_t r = {{st->s[0][lane], st->s[1][lane], st->s[2][lane], st->s[3][lane]}};
+    uint64_t v = rng_next(&r);
+    for (int i = 0; i < 4; i++) {
+        st->s[i][lane] = r.s[i];
+    }
+    return v;
+}
+
+/*
+ * Скалярная часть: точки с from по points-1 (from кратно KERNEL_LANES).
+ * Векторные варианты дочищают ею хвост короче KERNEL_LANES точек.
+ */
+static long kernel_scalar_from(kernel_state_t *st, long from, long points) {
+    long inside = 0;
+    for (long k = from; k < points; k++) {
+        int lane = (int) (k % KERNEL_LANES);
+        double x = rng_to_double(kernel_next(st, lane)) * 2.0 - 1.0;
+        double y = rng_to_double(kernel_next(st, lane)) * 2.0 - 1.0;
+        inside += (x * x + y * y <= 1.0);
+    }
+    return inside;
+}
+
+// Запасной вариант для процессоров без AVX2
+static long kernel_scalar(uint64_t seed, uint64_t block, long points) {
+    kernel_state_t st;
+    kernel_seed(&st, seed, block);
+    return kernel_scalar_from(&st, 0, points);
+}
+
+#ifdef KERNEL_HAVE_X86
+//------------------------------------------------------------------------------
+// AVX2 + FMA: 8 потоков в двух регистрах по 4
+
+__attribute__((target("avx2,fma")))
+static inline __m256i kernel_next_avx2(__m256i *s0, __m256i *s1, __m256i *s2, __m256i *s3) {
+    __m256i result = _mm256_add_epi64(*s0, *s3);
+    __m256i t = _mm256_slli_epi64(*s1, 17);
+    *s2 = _mm256_xor_si256(*s2, *s0);
+    *s3 = _mm256_xor_si256(*s3, *s1);
+    *s1 = _mm256_xor_si256(*s1, *s2);
+    *s0 = _mm256_xor_si256(*s0, *s3);
+    *s2 = _mm256_xor_si256(*s2, t);
+    *s3 = _mm256_or_si256(_mm256_slli_epi64(*s3, 45), _mm256_srli_epi64(*s3, 19));
+    return result;
+}
+
+// 64 бита -> double в [-1, 1): мантисса из старших бит, затем 2u - 1 одной FMA
+__attribute__((target("avx2,fma")))
+static inline __m256d kernel_coord_avx2(__m256i v) {
+    const __m256i one_bits = _mm256_set1_epi64x(0x3FF0000000000000LL);
+    __m256d u = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(v, 12), one_bits)),
+                              _mm256_set1_pd(1.0));
+    return _mm256_fmadd_pd(u, _mm256_set1_pd(2.0), _mm256_set1_pd(-1.0));
+}
+
+__attribute__((target("avx2,fma")))
+static long kernel_avx2(uint64_t seed, uint64_t block, long points) {
+    kernel_state_t st;
+    kernel_seed(&st, seed, block);
+
+    __m256i a0 = _mm256_loadu_si256((const __m256i *) &st.s[0][0]);
+    __m256i a1 = _mm256_loadu_si256((const __m256i *) &st.s[1][0]);
+    __m256i a2 = _mm256_loadu_si256((const __m256i *) &st.s[2][0]);
+    __m256i a3 = _mm256_loadu_si256((const __m256i *) &st.s[3][0]);
+    __m256i b0 = _mm256_loadu_si256((const __m256i *) &st.s[0][4]);
+    __m256i b1 = _mm256_loadu_si256((const __m256i *) &st.s[1][4]);
+    __m256i b2 = _mm256_loadu_si256((const __m256i *) &st.s[2][4]);
+    __m256i b3 = _mm256_loadu_si256((const __m256i *) &st.s[3][4]);
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    long inside = 0;
+    long k = 0;
+    for (; k + KERNEL_LANES <= points; k += KERNEL_LANES) {
+        __m256d xa = kernel_coord_avx2(kernel_next_avx2(&a0, &a1, &a2, &a3));
+        __m256d xb = kernel_coord_avx2(kernel_next_avx2(&b0, &b1, &b2, &b3));
+        __m256d ya = kernel_coord_avx2(kernel_next_avx2(&a0, &a1, &a2, &a3));
+        __m256d yb = kernel_coord_avx2(kernel_next_avx2(&b0, &b1, &b2, &b3));
+        __m256d da = _mm256_fmadd_pd(xa, xa, _mm256_mul_pd(ya, ya));
+        __m256d db = _mm256_fmadd_pd(xb, xb, _mm256_mul_pd(yb, yb));
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(da, one, _CMP_LE_OQ))
+                 | _mm256_movemask_pd(_mm256_cmp_pd(db, one, _CMP_LE_OQ)) << 4;
+        inside += __builtin_popcount((unsigned) mask);
+    }
+
+    _mm256_storeu_si256((__m256i *) &st.s[0][0], a0);
+    _mm256_storeu_si256((__m256i *) &st.s[1][0], a1);
+    _mm256_storeu_si256((__m256i *) &st.s[2][0], a2);
+    _mm256_storeu_si256((__m256i *) &st.s[3][0], a3);
+    _mm256_storeu_si256((__m256i *) &st.s[0][4], b0);
+    _mm256_storeu_si256((__m256i *) &st.s[1][4], b1);
+    _mm256_storeu_si256((__m256i *) &st.s[2][4], b2);
+    _mm256_storeu_si256((__m256i *) &st.s[3][4], b3);
+    return inside + kernel_scalar_from(&st, k, points);
+}
+
+//------------------------------------------------------------------------------
+// AVX-512: 8 потоков в одном регистре, маска сравнения сразу битовая
+
+__attribute__((target("avx512f")))
+static long kernel_avx512(uint64_t seed, uint64_t block, long points) {
+    kernel_state_t st;
+    kernel_seed(&st, seed, block);
+
+    __m512i s0 = _mm512_loadu_si512(&st.s[0][0]);
+    __m512i s1 = _mm512_loadu_si512(&st.s[1][0]);
+    __m512i s2 = _mm512_loadu_si512(&st.s[2][0]);
+    __m512i s3 = _mm512_loadu_si512(&st.s[3][0]);
+    const __m512i one_bits = _mm512_set1_epi64(0x3FF0000000000000LL);
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d two = _mm512_set1_pd(2.0);
+    const __m512d minus_one = _mm512_set1_pd(-1.0);
+
+    long inside = 0;
+    long k = 0;
+    for (; k + KERNEL_LANES <= points; k += KERNEL_LANES) {
+        __m512d c[2];
+        for (int j = 0; j < 2; j++) {
+            __m512i v = _mm512_add_epi64(s0, s3);
+            __m512i t = _mm512_slli_epi64(s1, 17);
+            s2 = _mm512_xor_si512(s2, s0);
+            s3 = _mm512_xor_si512(s3, s1);
+            s1 = _mm512_xor_si512(s1, s2);
+            s0 = _mm512_xor_si512(s0, s3);
+            s2 = _mm512_xor_si512(s2, t);
+            s3 = _mm512_rol_epi64(s3, 45);
+
+            __m512d u = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(_mm512_srli_epi64(v, 12), one_bits)), one);
+            c[j] = _mm512_fmadd_pd(u, two, minus_one);
+        }
+        __m512d d = _mm512_fmadd_pd(c[0], c[0], _mm512_mul_pd(c[1], c[1]));
+        __mmask8 m = _mm512_cmp_pd_mask(d, one, _CMP_LE_OQ);
+        inside += __builtin_popcount((unsigned) m);
+    }
+
+    _mm512_storeu_si512(&st.s[0][0], s0);
+    _mm512_storeu_si512(&st.s[1][0], s1);
+    _mm512_storeu_si512(&st.s[2][0], s2);
+    _mm512_storeu_si512(&st.s[3][0], s3);
+    return inside + kernel_scalar_from(&st, k, points);
+}
+#endif // KERNEL_HAVE_X86
+
+//------------------------------------------------------------------------------
+// Выбор варианта под текущий процессор
+
+static inline kernel_fn kernel_select(const char **name) {
+#ifdef KERNEL_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        *name = "avx512";
+        return kernel_avx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        *name = "avx2";
+        return kernel_avx2;
+    }
+#endif
+    *name = "scalar";
+    return kernel_scalar;
+}
+
+#endif // LAB2_KERNEL_H
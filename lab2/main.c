@@ -1,41 +1,162 @@
 /******************************************************************************
  * Запуск:
- *     ./lab2 5.0 4
- *  где 5.0  — радиус окружности,
- *      4    — максимальное число одновременно работающих потоков.
+ *     ./lab2 5.0 4 [опции]
+ *  где 5.0     — радиус окружности,
+ *      4       — максимальное число одновременно работающих потоков,
+ *      --points — сколько всего точек сгенерировать (по умолчанию 100M),
+ *      --chunk — размер задачи в точках или auto (по умолчанию): размер
+ *                подбирается по числу потоков и замеренному времени задач,
+ *      --steal — раздать задачи потокам диапазонами и разрешить свободным
+ *                потокам забирать половину чужого остатка (кража работы),
+ *      --target-se X / --target-ci X — остановиться, как только стандартная
+ *                ошибка площади (или полуширина 95% доверительного
+ *                интервала) не больше X; X с '%' — доля от самой площади.
+ *                --points тогда — верхний предел,
+ *      --sampler prng|sobol|halton — откуда брать точки: ГПСЧ (по умолчанию)
+ *                или последовательность с низким расхождением (QMC, только
+ *                для круга; ошибка — по QMC_REPLICAS рандомизированным
+ *                репликам, см. qmc.h),
+ *      --region ОБЛАСТЬ — что мерить вместо круга: ellipse:A,B,
+ *                polygon:X1,Y1,X2,Y2,..., ball:N (N-мерный шар радиуса R),
+ *                plugin:ПУТЬ.so[:АРГ] (см. region.h),
+ *      --affinity compact|scatter|СПИСОК — привязать потоки к процессорам
+ *                (см. affinity.h) и напечатать отчёт, как с --report,
+ *      --report — по каждому потоку: процессор, узел NUMA, точки, время
+ *                работы и простоя, точек в секунду; итоги по узлам,
+ *      --batch ФАЙЛ|- — пакетный режим: запросы "радиус [точек]" по строке
+ *                из файла или stdin, ответы "радиус точек площадь ошибка"
+ *                (радиус из командной строки не используется, см. ниже),
+ *      --bench csv|json — замер масштабирования вместо одного расчёта:
+ *                время, точек в секунду, простой потоков и отклонение от
+ *                точной площади для каждого сочетания
+ *                --bench-threads N,... (по умолчанию 1, 2, 4, ..., до
+ *                max_threads) и --bench-chunks N|auto,... (по умолчанию
+ *                --chunk), по --bench-repeat раз (3).
+ *  Вместе с оценкой печатается её стандартная ошибка.
+ *  Числа можно писать как 1e9.
+ *
+ * Сборка:
+ *     gcc -O2 -pthread -o lab2 main.c -lm -ldl
  ******************************************************************************/
 
-#include <stdlib.h>    /* atof, atoi, rand, srand */
+#define _GNU_SOURCE    /* pthread_attr_setaffinity_np, sched_getcpu */
+
+#include <stdlib.h>    /* atof, atoi, strtod */
 #include <unistd.h>    /* write, _exit, getpid */
-#include <pthread.h>   /* pthread_create, pthread_join, pthread_mutex_* */
-#include <time.h>      /* time (для srand), можно заменить при желании */
+#include <pthread.h>   /* pthread_create, pthread_join */
 #include <string.h>    /* для обработки строк в функциях конвертации */
+#include <stdatomic.h> /* счётчик задач и диапазоны краж без мьютексов */
+#include <time.h>      /* clock_gettime: время задач для --chunk auto */
+#include <math.h>      /* sqrt: стандартная ошибка для --target-* */
+
+#include "rng.h"       /* xoshiro256+: свой ГПСЧ у каждой задачи */
+#include "kernel.h"    /* подсчёт попаданий: AVX-512 / AVX2 / скалярный */
+#include "qmc.h"       /* квази-Монте-Карло: Соболь, Холтон */
+#include "region.h"    /* области: эллипс, многоугольник, шар, модули */
+#include "affinity.h"  /* привязка потоков к процессорам, узлы NUMA */
 
 //------------------------------------------------------------------------------
 // Настройки «метода Монте-Карло»:
 
 /*
- * Общее количество случайных точек, которые будем генерировать.
+ * Общее количество случайных точек по умолчанию (--points).
  * Чем больше точек, тем точнее результат, но дольше время вычисления.
  */
 #define TOTAL_POINTS 100000000
 
 /*
- * Размер "задачи" — количество точек, обрабатываемых одним потоком за один раз.
- * Если TOTAL_POINTS=1_000_000, а CHUNK_SIZE=100_000, то будет 10 "задач".
+ * Точки нумеруются подряд и режутся на блоки по BLOCK_POINTS; у каждого
+ * блока свои потоки ГПСЧ (номер блока вместо номера задачи) или свой
+ * отрезок QMC-последовательности. Задача — это несколько блоков подряд,
+ * поэтому результат не зависит ни от числа потоков, ни от размера задачи:
+ * меняется только то, кто какой блок считает.
+ * Размер задачи (--chunk) округляется вверх до целых блоков.
+ */
+#define BLOCK_POINTS KERNEL_BLOCK_POINTS
+
+/*
+ * --chunk auto: поток замеряет, сколько у него уходит на блок, и берёт
+ * столько блоков, чтобы задача шла около AUTO_TASK_NS — взятие задачи
+ * (один атомик) на этом фоне бесплатно. Чтобы к концу не остался один
+ * долгий хвост, задача не больше 1/AUTO_SPLIT остатка на поток (как
+ * в guided-планировании OpenMP). Первая задача — пробная, в один блок.
  */
-#define CHUNK_SIZE 10000000
+#define AUTO_TASK_NS 2000000L
+#define AUTO_SPLIT 2
+
+/*
+ * --target-*: оценка погрешности — по разбросу долей попаданий в полных
+ * блоках (блоки независимы и одного размера). Пока блоков меньше
+ * TARGET_MIN_BLOCKS, дисперсия по ним слишком шумная, и не проверяем.
+ * Для QMC блоки одной последовательности зависимы, и такая оценка там
+ * неверна (завышена во много раз) — ошибку даёт разброс оценок независимых
+ * реплик (qmc.h, replica_error()).
+ * TARGET_CI_Z — квантиль нормального распределения для 95% интервала.
+ */
+#define TARGET_MIN_BLOCKS 32
+#define TARGET_CI_Z 1.959964
+
+#define CACHE_LINE 64
 
 //------------------------------------------------------------------------------
 // Глобальные переменные для управления задачами:
 
-static int g_totalTasks = 0;       // Общее число «задач»
-static int g_nextTask = 0;       // Индекс следующей «задачи»
-static long g_insideCount = 0;       // Счётчик точек, попавших внутрь окружности
+static long g_totalPoints = TOTAL_POINTS; // Сколько всего точек (--points)
+static long g_totalBlocks = 0;     // Столько же в блоках, последний может быть неполным
+static long g_chunkBlocks = 0;     // Размер задачи в блоках, 0 — подбирать (--chunk auto)
+static _Atomic long g_nextBlock = 0; // Первый ещё не выданный блок (общая очередь)
 static double g_radius = 1.0;     // Радиус окружности (считывается из argv)
+static uint64_t g_seed = RNG_DEFAULT_SEED; // Общее зерно ГПСЧ, потоки блоков выводятся из него
+static kernel_fn g_kernel = kernel_scalar;  // Вариант ядра под процессор (kernel_select())
+static int g_steal = 0;           // Режим кражи работы (--steal)
+static const char *g_sampler = "prng"; // Источник точек (--sampler)
+static int g_qmc = 0;             // Точки из QMC-последовательности (sobol, halton)
+static double g_boxVolume = 4.0;  // Объём параллелепипеда, в который бросаем точки
+static double g_target = 0.0;     // Нужная погрешность площади (--target-*), 0 — считать все точки
+static int g_targetRelative = 0;  // g_target задан в долях площади ('%')
+static atomic_int g_stop = 0;     // Погрешность достигнута: задач больше не брать
 
-static pthread_mutex_t g_taskMutex = PTHREAD_MUTEX_INITIALIZER;  // для g_nextTask
-static pthread_mutex_t g_resultMutex = PTHREAD_MUTEX_INITIALIZER;  // для g_insideCount
+/*
+ * Своё у каждого потока. Счётчик попаданий поток копит у себя и никому не
+ * отдаёт до pthread_join — main сложит всё сам, без мьютекса.
+ *
+ * range — диапазон блоков потока в режиме кражи: [begin, end) упакованы в
+ * одно 64-битное слово (begin — младшие 32 бита), поэтому и владелец,
+ * и вор меняют его одним CAS.
+ *
+ * stat* — итоги по полным блокам для оценки погрешности: сумма попаданий
+ * и сумма их квадратов. Поток публикует их после каждой задачи, читает
+ * любой поток, проверяющий погрешность (--target-*), и main в конце. Три поля пишутся не разом, и читатель
+ * может увидеть их из разных задач — для оценки погрешности это неважно.
+ *
+ * range и stat* читают чужие потоки, остальное — только свой, поэтому
+ * они на разных линиях кэша.
+ */
+typedef struct {
+    _Alignas(CACHE_LINE) _Atomic uint64_t range;
+    _Atomic long statBlocks;
+    _Atomic long statHits;
+    _Atomic double statHitsSq;
+    _Alignas(CACHE_LINE) long insideCount; // Счётчик точек, попавших внутрь окружности
+    long pointCount;                  // Сколько точек поток посчитал
+    double nsPerBlock;                // Замеренное время блока (для --chunk auto), 0 — ещё нет
+    long busyNs;                      // Время в задачах
+    long wallNs;                      // Время жизни потока (простой = wallNs - busyNs)
+    int index;
+    int cpu;                          // Процессор (по --affinity или где поток начал), узел
+    int node;
+} worker_t;
+
+static worker_t *g_workers = NULL;
+static int g_workerCount = 0;
+
+/*
+ * QMC: попадания и точки по репликам (qmc.h) — для оценки погрешности по
+ * разбросу их оценок. Потоки добавляют сюда итоги каждой задачи.
+ */
+static _Atomic long g_replicaHits[QMC_REPLICAS];
+static _Atomic long g_replicaPoints[QMC_REPLICAS];
+static affinity_topology_t g_topology; // Узлы NUMA процессоров (affinity.h)
 
 //------------------------------------------------------------------------------
 /*
@@ -134,71 +255,1041 @@ static void write_str(const char *s) {
     write(STDOUT_FILENO, s, len);
 }
 
+static void write_long(long value) {
+    char buf[32];
+    if (value < 0) {
+        write_str("-");
+    }
+    my_itoa(value, buf);
+    write_str(buf);
+}
+
+static void write_double(double value, int precision) {
+    char buf[64];
+    my_dtoa(value, buf, precision);
+    write_str(buf);
+}
+
 //------------------------------------------------------------------------------
-// Функция получения индекса следующей задачи:
+// Функции получения следующей задачи (first — первый блок, count — сколько):
 
-static int get_next_task(void) {
-    pthread_mutex_lock(&g_taskMutex);
-    int taskIndex = -1;
-    if (g_nextTask < g_totalTasks) {
-        taskIndex = g_nextTask;
-        g_nextTask++;
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// Сколько блоков хотим взять следующей задачей; remaining — сколько блоков
+// осталось в той очереди, из которой берём
+static long chunk_blocks(const worker_t *self, long remaining) {
+    if (g_chunkBlocks > 0) {
+        return g_chunkBlocks;
+    }
+    if (self->nsPerBlock <= 0.0) {
+        return 1;
+    }
+    long want = (long) (AUTO_TASK_NS / self->nsPerBlock);
+    long cap = remaining / ((long) g_workerCount * AUTO_SPLIT);
+    if (want > cap) {
+        want = cap;
+    }
+    return want > 0 ? want : 1;
+}
+
+// Общая очередь: задача — просто fetch_add по счётчику блоков
+static int take_shared_task(worker_t *self, long *first, long *count) {
+    if (atomic_load_explicit(&g_stop, memory_order_relaxed)) {
+        return 0;
+    }
+    long want = chunk_blocks(self, g_totalBlocks - atomic_load_explicit(&g_nextBlock, memory_order_relaxed));
+    long begin = atomic_fetch_add_explicit(&g_nextBlock, want, memory_order_relaxed);
+    if (begin >= g_totalBlocks) {
+        return 0;
+    }
+    *first = begin;
+    *count = begin + want <= g_totalBlocks ? want : g_totalBlocks - begin;
+    return 1;
+}
+
+static uint64_t range_pack(uint32_t begin, uint32_t end) {
+    return (uint64_t) end << 32 | begin;
+}
+
+static uint32_t range_begin(uint64_t range) {
+    return (uint32_t) range;
+}
+
+static uint32_t range_end(uint64_t range) {
+    return (uint32_t) (range >> 32);
+}
+
+// Владелец берёт задачу с начала своего диапазона. В режиме кражи
+// остаток делят воры, поэтому задача ограничена только самим диапазоном.
+static int take_own_task(worker_t *self, long *first, long *count) {
+    uint64_t range = atomic_load_explicit(&self->range, memory_order_relaxed);
+    while (range_begin(range) < range_end(range)) {
+        uint32_t left = range_end(range) - range_begin(range);
+        long want = chunk_blocks(self, (long) left * g_workerCount * AUTO_SPLIT);
+        uint32_t take = want < (long) left ? (uint32_t) want : left;
+        uint64_t next = range_pack(range_begin(range) + take, range_end(range));
+        if (atomic_compare_exchange_weak(&self->range, &range, next)) {
+            *first = range_begin(range);
+            *count = take;
+            return 1;
+        }
     }
-    pthread_mutex_unlock(&g_taskMutex);
-    return taskIndex;
+    return 0;
+}
+
+/*
+ * Вор: находит поток с самым большим остатком и забирает верхнюю половину
+ * (при остатке в один блок — его самого) себе в диапазон. Возвращает 0, если
+ * красть нечего — работа кончилась у всех.
+ */
+static int steal_tasks(worker_t *self) {
+    while (1) {
+        worker_t *victim = NULL;
+        uint64_t victimRange = 0;
+        uint32_t best = 0;
+        for (int i = 0; i < g_workerCount; i++) {
+            uint64_t range = atomic_load_explicit(&g_workers[i].range, memory_order_relaxed);
+            uint32_t left = range_end(range) - range_begin(range);
+            if (i != self->index && range_begin(range) < range_end(range) && left > best) {
+                best = left;
+                victim = &g_workers[i];
+                victimRange = range;
+            }
+        }
+        if (!victim) {
+            return 0;
+        }
+
+        uint32_t begin = range_begin(victimRange);
+        uint32_t end = range_end(victimRange);
+        uint32_t mid = begin + (end - begin) / 2;
+        if (atomic_compare_exchange_strong(&victim->range, &victimRange, range_pack(begin, mid))) {
+            // В свой диапазон пишем только мы (он пуст, красть у нас нечего)
+            atomic_store(&self->range, range_pack(mid, end));
+            return 1;
+        }
+        // Диапазон жертвы изменился, пока мы выбирали, — пробуем заново
+    }
+}
+
+static int take_steal_task(worker_t *self, long *first, long *count) {
+    while (!atomic_load_explicit(&g_stop, memory_order_relaxed)) {
+        if (take_own_task(self, first, count)) {
+            return 1;
+        }
+        if (!steal_tasks(self)) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// Ранняя остановка (--target-*):
+
+/*
+ * QMC: стандартная ошибка по R = QMC_REPLICAS независимым репликам с
+ * оценками доли p_r = hits_r / points_r: s^2 = sum (p_r - p)^2 / (R - 1),
+ * ошибка среднего — s / sqrt(R), умноженная на объём параллелепипеда.
+ * Возвращает 0, если какой-то реплике ещё не досталось ни одной точки.
+ */
+static int replica_error(const long *hits, const long *points, double volume, double *stdError) {
+    double fraction[QMC_REPLICAS];
+    double mean = 0.0;
+    for (int r = 0; r < QMC_REPLICAS; r++) {
+        if (points[r] == 0) {
+            return 0;
+        }
+        fraction[r] = (double) hits[r] / (double) points[r];
+        mean += fraction[r] / QMC_REPLICAS;
+    }
+    double variance = 0.0;
+    for (int r = 0; r < QMC_REPLICAS; r++) {
+        variance += (fraction[r] - mean) * (fraction[r] - mean) / (QMC_REPLICAS - 1);
+    }
+    *stdError = sqrt(variance / QMC_REPLICAS) * volume;
+    return 1;
+}
+
+static int replica_error_global(double *stdError) {
+    long hits[QMC_REPLICAS], points[QMC_REPLICAS];
+    for (int r = 0; r < QMC_REPLICAS; r++) {
+        points[r] = atomic_load_explicit(&g_replicaPoints[r], memory_order_relaxed);
+        hits[r] = atomic_load_explicit(&g_replicaHits[r], memory_order_relaxed);
+    }
+    return replica_error(hits, points, g_boxVolume, stdError);
+}
+
+/*
+ * Площадь (объём) и её стандартная ошибка по опубликованным итогам всех
+ * потоков. По k полным блокам с попаданиями h_i: дисперсия одного блока
+ * s^2 = (sum h_i^2 - (sum h_i)^2 / k) / (k - 1), ошибка среднего — s / sqrt(k),
+ * всё в долях блока и умножено на объём параллелепипеда. Для QMC ошибка —
+ * по репликам (replica_error()).
+ * Возвращает 0, если полных блоков пока слишком мало.
+ */
+static int estimate_error(double *area, double *stdError) {
+    long blocks = 0;
+    long hits = 0;
+    double hitsSq = 0.0;
+    for (int i = 0; i < g_workerCount; i++) {
+        blocks += atomic_load_explicit(&g_workers[i].statBlocks, memory_order_relaxed);
+        hits += atomic_load_explicit(&g_workers[i].statHits, memory_order_relaxed);
+        hitsSq += atomic_load_explicit(&g_workers[i].statHitsSq, memory_order_relaxed);
+    }
+    if (blocks < TARGET_MIN_BLOCKS) {
+        return 0;
+    }
+
+    double k = (double) blocks;
+    *area = (double) hits / (k * BLOCK_POINTS) * g_boxVolume;
+    if (g_qmc) {
+        return replica_error_global(stdError);
+    }
+    double variance = (hitsSq - (double) hits * (double) hits / k) / (k - 1.0);
+    *stdError = sqrt((variance > 0.0 ? variance : 0.0) / k) / BLOCK_POINTS * g_boxVolume;
+    return 1;
+}
+
+// Достигнута ли заказанная погрешность
+static int target_reached(void) {
+    double area, stdError;
+    if (!estimate_error(&area, &stdError)) {
+        return 0;
+    }
+    double target = g_targetRelative ? g_target * area : g_target;
+    return stdError <= target;
 }
 
 //------------------------------------------------------------------------------
 // Функция, которую выполняет каждый поток (worker):
 // - в цикле получает очередной индекс задачи
 // - если задача есть, генерирует точки и считает, сколько попало внутрь окружности
-// - добавляет результат к глобальному счётчику g_insideCount
+// - копит результат в своём worker_t, main суммирует их после join
 
 static void *thread_worker(void *arg) {
-    (void) arg; // не используем, но аргумент оставить для сигнатуры pthread
+    worker_t *self = (worker_t *) arg;
+    long threadStart = now_ns();
 
-    // Инициализируем ГПСЧ для каждого потока индивидуально,
-    // чтобы потоки не "мешали" друг другу при rand().
-    unsigned seed = (unsigned) time(NULL) ^ (unsigned) pthread_self();
-    srand(seed);
+    if (self->cpu < 0) {
+        // Не привязан — для отчёта запомним, где начал (дальше может переехать)
+        self->cpu = sched_getcpu();
+        self->node = self->cpu >= 0 && self->cpu < AFFINITY_MAX_CPUS ? g_topology.nodeOf[self->cpu] : -1;
+    }
 
     while (1) {
-        int taskIndex = get_next_task();
-        if (taskIndex < 0) {
+        long first, count;
+        int got = g_steal ? take_steal_task(self, &first, &count) : take_shared_task(self, &first, &count);
+        if (!got) {
             // Задачи кончились, выходим из цикла
             break;
         }
 
-        // Вычислим, сколько точек нужно сгенерировать в рамках этой задачи:
-        long pointsPerTask = CHUNK_SIZE;
+        long start = now_ns();
+
+        // Подсчёт, сколько точек попало внутрь области.
+        // Ядро круга генерирует точки в квадрате [-1, 1) x [-1, 1) и проверяет
+        // x^2 + y^2 <= 1 — это то же самое, что квадрат [-R, R] и круг
+        // радиуса R, поделённые на R; масштаб учтём в площади. Ядра других
+        // областей бросают точки прямо в их параллелепипед (region.h).
+        // ГПСЧ блока зависит только от номера блока — результат воспроизводим.
+        long taskHits = 0;
+        double taskHitsSq = 0.0;
+        long fullBlocks = 0;
+        long replicaHits[QMC_REPLICAS] = {0};
+        long replicaPoints[QMC_REPLICAS] = {0};
+        for (long block = first; block < first + count; block++) {
+            long points = g_totalPoints - block * BLOCK_POINTS;
+            if (points > BLOCK_POINTS) {
+                points = BLOCK_POINTS;
+            }
+            long hits = g_kernel(g_seed, (uint64_t) block, points);
+            self->insideCount += hits;
+            self->pointCount += points;
+            if (points == BLOCK_POINTS) {
+                taskHits += hits;
+                taskHitsSq += (double) hits * (double) hits;
+                fullBlocks++;
+            }
+            if (g_qmc) {
+                replicaHits[qmc_replica((uint64_t) block)] += hits;
+                replicaPoints[qmc_replica((uint64_t) block)] += points;
+            }
+        }
+        for (int r = 0; g_qmc && r < QMC_REPLICAS; r++) {
+            if (replicaPoints[r] > 0) {
+                atomic_fetch_add_explicit(&g_replicaHits[r], replicaHits[r], memory_order_relaxed);
+                atomic_fetch_add_explicit(&g_replicaPoints[r], replicaPoints[r], memory_order_relaxed);
+            }
+        }
+
+        // Пишет только владелец, поэтому load + store, а не fetch_add
+        atomic_store_explicit(&self->statBlocks, self->statBlocks + fullBlocks, memory_order_relaxed);
+        atomic_store_explicit(&self->statHits, self->statHits + taskHits, memory_order_relaxed);
+        atomic_store_explicit(&self->statHitsSq, self->statHitsSq + taskHitsSq, memory_order_relaxed);
+        if (g_target > 0.0 && target_reached()) {
+            atomic_store_explicit(&g_stop, 1, memory_order_relaxed);
+        }
+
+        long taskNs = now_ns() - start;
+        self->busyNs += taskNs;
+
+        if (g_chunkBlocks == 0) {
+            // Скользящее среднее: одна задача, прерванная планировщиком,
+            // не должна сразу раздувать или дробить следующие
+            double perBlock = (double) taskNs / (double) count;
+            self->nsPerBlock = self->nsPerBlock > 0.0 ? (self->nsPerBlock + perBlock) / 2.0 : perBlock;
+        }
+    }
+
+    self->wallNs = now_ns() - threadStart;
+    return NULL;
+}
+
+/*
+ * Разбор неотрицательного целого из аргумента, допускается запись 1e9.
+ * Возвращает -1, если это не целое число.
+ */
+static long parse_count(const char *s) {
+    char *end;
+    double v = strtod(s, &end);
+    if (end == s || *end != '\0' || v < 0.0 || v > 9.0e18 || v != (double) (long) v) {
+        return -1;
+    }
+    return (long) v;
+}
+
+/*
+ * Разбор погрешности для --target-*: положительное число, с '%' на конце —
+ * доля от площади. Возвращает 0 при ошибке.
+ */
+static int parse_target(const char *s) {
+    char *end;
+    double v = strtod(s, &end);
+    if (end == s || !(v > 0.0)) {
+        return 0;
+    }
+    if (end[0] == '%' && end[1] == '\0') {
+        g_target = v / 100.0;
+        g_targetRelative = 1;
+        return 1;
+    }
+    g_target = v;
+    g_targetRelative = 0;
+    return *end == '\0';
+}
+
+//------------------------------------------------------------------------------
+/*
+ * Пакетный режим (--batch ФАЙЛ или --batch - для stdin): пул потоков
+ * создаётся один раз и отвечает на поток запросов "радиус [точек]" — по
+ * строке на запрос; пустые строки и строки с '#' пропускаются. Ответ —
+ * строка "радиус точек площадь ошибка", в порядке запросов.
+ *
+ * Запросы идут конвейером: блоки всех запросов пронумерованы подряд
+ * в одной сквозной нумерации, и потоки берут их тем же fetch_add-подобным
+ * CAS по g_nextBlock, что и в обычном режиме. Дочитав блоки одного запроса,
+ * поток сразу берёт блоки следующего — хвост запроса не ждёт остальных,
+ * и пока одни потоки доделывают запрос, другие уже считают следующий.
+ * Задача не переходит через границу запроса, а адаптивный размер задачи
+ * ограничен остатком запроса — маленький запрос делится на весь пул.
+ *
+ * Запросы лежат в кольце на BATCH_WINDOW мест: main читает вход, кладёт
+ * запрос в кольцо и публикует его блоки (g_batchBlocks). Ответы печатает
+ * поток, досчитавший запрос, — все готовые по порядку. Когда кольцо полно,
+ * main ждёт ответа на старейший запрос — так вход любой длины идёт
+ * в ограниченной памяти.
+ * Блоки запроса нумеруются для ГПСЧ с нуля — ответ тот же, что у обычного
+ * запуска с тем же радиусом и --points.
+ *
+ * Поток спит на g_batchCond, только когда опубликованные блоки кончились;
+ * main спит на нём же, когда ждёт места в кольце. Пока работа есть,
+ * мьютекс берётся только раз на запрос — чтобы напечатать ответ.
+ */
+#define BATCH_WINDOW 256
+#define BATCH_LINE_MAX 256
+
+typedef struct {
+    double radius;
+    long points;
+    long firstBlock;               // первый блок в сквозной нумерации
+    long blocks;
+    _Atomic long hits;
+    _Atomic long donePoints;       // досчитано точек; == points — ответ готов
+    _Atomic long replicaHits[QMC_REPLICAS]; // QMC: попадания по репликам
+} batch_query_t;
+
+static batch_query_t g_batch[BATCH_WINDOW];
+static _Atomic long g_batchPublished = 0; // Запросов в кольце всего (номер следующего)
+static _Atomic long g_batchOldest = 0;    // Старейший неотвеченный запрос
+static _Atomic long g_batchBlocks = 0;    // Опубликовано блоков (конец последнего запроса)
+static _Atomic int g_batchEof = 0;        // Вход кончился, новых запросов не будет
+static pthread_mutex_t g_batchMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_batchCond = PTHREAD_COND_INITIALIZER;
+
+static batch_query_t *batch_query(long seq) {
+    return &g_batch[seq % BATCH_WINDOW];
+}
+
+/*
+ * Взять задачу: блоки [first, first + count) запроса *seq. cursor — номер
+ * запроса, на котором поток остановился (блоки раздаются по возрастанию,
+ * поэтому дальше он только растёт). 0 — опубликованных блоков не осталось.
+ */
+static int batch_take_task(worker_t *self, long *cursor, long *seq, long *first, long *count) {
+    long begin = atomic_load_explicit(&g_nextBlock, memory_order_relaxed);
+    while (1) {
+        if (begin >= atomic_load_explicit(&g_batchBlocks, memory_order_acquire)) {
+            return 0;
+        }
+        // Блок begin ещё не посчитан, значит его запрос не старее g_batchOldest
+        long oldest = atomic_load_explicit(&g_batchOldest, memory_order_acquire);
+        if (*cursor < oldest) {
+            *cursor = oldest;
+        }
+        batch_query_t *q = batch_query(*cursor);
+        while (begin >= q->firstBlock + q->blocks) {
+            q = batch_query(++*cursor);
+        }
+
+        long end = q->firstBlock + q->blocks;
+        long want = chunk_blocks(self, end - begin);
+        long take = begin + want <= end ? want : end - begin;
+        if (atomic_compare_exchange_weak(&g_nextBlock, &begin, begin + take)) {
+            *seq = *cursor;
+            *first = begin;
+            *count = take;
+            return 1;
+        }
+    }
+}
+
+/*
+ * Под g_batchMutex: напечатать ответы на готовые запросы по порядку.
+ * Вызывает поток, досчитавший запрос, — так ответ выходит сразу, даже
+ * если main в это время ждёт ввода. Ждущих (main — места в кольце или
+ * конца, потоки — работы) будит тот же broadcast.
+ */
+static void batch_flush_locked(void) {
+    long oldest = atomic_load(&g_batchOldest);
+    while (oldest != atomic_load(&g_batchPublished)) {
+        batch_query_t *q = batch_query(oldest);
+        if (atomic_load(&q->donePoints) != q->points) {
+            break;
+        }
+
+        double square = 4.0 * q->radius * q->radius;
+        double fraction = (double) atomic_load(&q->hits) / (double) q->points;
+        double stdError = sqrt(fraction * (1.0 - fraction) / (double) q->points) * square;
+        int haveError = 1;
+        if (g_qmc) {
+            // Блоки запроса раздаются репликам по кругу с нуля
+            long hits[QMC_REPLICAS], points[QMC_REPLICAS] = {0};
+            for (long block = 0; block < q->blocks; block++) {
+                long blockPoints = q->points - block * BLOCK_POINTS;
+                points[qmc_replica((uint64_t) block)] += blockPoints < BLOCK_POINTS ? blockPoints : BLOCK_POINTS;
+            }
+            for (int r = 0; r < QMC_REPLICAS; r++) {
+                hits[r] = atomic_load(&q->replicaHits[r]);
+            }
+            haveError = replica_error(hits, points, square, &stdError);
+        }
+        char line[160];
+        int len = my_dtoa(q->radius, line, 6);
+        line[len++] = ' ';
+        len += my_itoa(q->points, line + len);
+        line[len++] = ' ';
+        len += my_dtoa(fraction * square, line + len, 6);
+        line[len++] = ' ';
+        if (haveError) {
+            len += my_dtoa(stdError, line + len, 9);
+        } else {
+            // QMC: блоков меньше, чем реплик, — оценить не по чему
+            memcpy(line + len, "nan", 3);
+            len += 3;
+        }
+        line[len++] = '\n';
+        write(STDOUT_FILENO, line, (size_t) len);
+
+        atomic_store(&g_batchOldest, ++oldest);
+    }
+    pthread_cond_broadcast(&g_batchCond);
+}
+
+static void *batch_worker(void *arg) {
+    worker_t *self = (worker_t *) arg;
+    long threadStart = now_ns();
+    long cursor = 0;
+
+    if (self->cpu < 0) {
+        self->cpu = sched_getcpu();
+        self->node = self->cpu >= 0 && self->cpu < AFFINITY_MAX_CPUS ? g_topology.nodeOf[self->cpu] : -1;
+    }
 
-        // Подсчёт, сколько точек попало внутрь окружности
-        long localInside = 0;
+    while (1) {
+        long seq, first, count;
+        if (!batch_take_task(self, &cursor, &seq, &first, &count)) {
+            // Работы нет: ждём новый запрос или конец входа
+            pthread_mutex_lock(&g_batchMutex);
+            while (atomic_load(&g_nextBlock) >= atomic_load(&g_batchBlocks) && !atomic_load(&g_batchEof)) {
+                pthread_cond_wait(&g_batchCond, &g_batchMutex);
+            }
+            int done = atomic_load(&g_nextBlock) >= atomic_load(&g_batchBlocks);
+            pthread_mutex_unlock(&g_batchMutex);
+            if (done) {
+                break;
+            }
+            continue;
+        }
 
-        // Координаты генерируем в квадрате [-R, R] x [-R, R].
-        // Площадь такого квадрата = (2R)*(2R) = 4R^2.
-        // Если (x^2 + y^2 <= R^2), значит точка внутри круга.
-        for (long i = 0; i < pointsPerTask; i++) {
-            // rand() возвращает число в диапазоне [0, RAND_MAX].
-            // Преобразуем в [-radius, +radius].
-            double x = ((double) rand() / (double) RAND_MAX) * 2.0 * g_radius - g_radius;
-            double y = ((double) rand() / (double) RAND_MAX) * 2.0 * g_radius - g_radius;
+        long start = now_ns();
+        batch_query_t *q = batch_query(seq);
+        long hits = 0, points = 0;
+        long replicaHits[QMC_REPLICAS] = {0};
+        for (long block = first - q->firstBlock; block < first - q->firstBlock + count; block++) {
+            long blockPoints = q->points - block * BLOCK_POINTS;
+            if (blockPoints > BLOCK_POINTS) {
+                blockPoints = BLOCK_POINTS;
+            }
+            long blockHits = g_kernel(g_seed, (uint64_t) block, blockPoints);
+            hits += blockHits;
+            points += blockPoints;
+            replicaHits[qmc_replica((uint64_t) block)] += blockHits;
+        }
+        self->insideCount += hits;
+        self->pointCount += points;
 
-            double dist2 = x * x + y * y;
-            if (dist2 <= (g_radius * g_radius)) {
-                localInside++;
+        for (int r = 0; g_qmc && r < QMC_REPLICAS; r++) {
+            if (replicaHits[r] > 0) {
+                atomic_fetch_add(&q->replicaHits[r], replicaHits[r]);
             }
         }
+        atomic_fetch_add(&q->hits, hits);
+        if (atomic_fetch_add(&q->donePoints, points) + points == q->points) {
+            // Запрос досчитан — печатаем всё, что готово по порядку
+            pthread_mutex_lock(&g_batchMutex);
+            batch_flush_locked();
+            pthread_mutex_unlock(&g_batchMutex);
+        }
 
-        // Добавим localInside к глобальному g_insideCount в потоко-безопасном режиме
-        pthread_mutex_lock(&g_resultMutex);
-        g_insideCount += localInside;
-        pthread_mutex_unlock(&g_resultMutex);
+        long taskNs = now_ns() - start;
+        self->busyNs += taskNs;
+        if (g_chunkBlocks == 0) {
+            double perBlock = (double) taskNs / (double) count;
+            self->nsPerBlock = self->nsPerBlock > 0.0 ? (self->nsPerBlock + perBlock) / 2.0 : perBlock;
+        }
     }
 
+    self->wallNs = now_ns() - threadStart;
     return NULL;
 }
 
+// Разбор строки запроса: 1 — запрос, 0 — пустая/комментарий, -1 — ошибка
+static int batch_parse(char *line, double *radius, long *points) {
+    while (*line == ' ' || *line == '\t') {
+        line++;
+    }
+    if (*line == '\0' || *line == '#') {
+        return 0;
+    }
+    char *end;
+    *radius = strtod(line, &end);
+    if (end == line || !(*radius > 0.0)) {
+        return -1;
+    }
+    while (*end == ' ' || *end == '\t') {
+        end++;
+    }
+    if (*end == '\0') {
+        *points = g_totalPoints;
+        return 1;
+    }
+    char *rest = end;
+    while (*rest && *rest != ' ' && *rest != '\t') {
+        rest++;
+    }
+    char saved = *rest;
+    *rest = '\0';
+    *points = parse_count(end);
+    *rest = saved;
+    while (*rest == ' ' || *rest == '\t') {
+        rest++;
+    }
+    return *points > 0 && *rest == '\0' ? 1 : -1;
+}
+
+// Поставить запрос в кольцо (если оно полно — сначала дождаться ответа)
+static void batch_submit(double radius, long points) {
+    pthread_mutex_lock(&g_batchMutex);
+    while (atomic_load(&g_batchPublished) - atomic_load(&g_batchOldest) == BATCH_WINDOW) {
+        pthread_cond_wait(&g_batchCond, &g_batchMutex);
+    }
+    pthread_mutex_unlock(&g_batchMutex);
+
+    long seq = atomic_load(&g_batchPublished);
+    batch_query_t *q = batch_query(seq);
+    q->radius = radius;
+    q->points = points;
+    q->firstBlock = atomic_load(&g_batchBlocks);
+    q->blocks = (points + BLOCK_POINTS - 1) / BLOCK_POINTS;
+    atomic_store(&q->hits, 0);
+    atomic_store(&q->donePoints, 0);
+    for (int r = 0; r < QMC_REPLICAS; r++) {
+        atomic_store(&q->replicaHits[r], 0);
+    }
+
+    // Сначала запрос, потом его блоки: увидевший блоки видит и запрос
+    atomic_store(&g_batchPublished, seq + 1);
+    pthread_mutex_lock(&g_batchMutex);
+    atomic_store_explicit(&g_batchBlocks, q->firstBlock + q->blocks, memory_order_release);
+    pthread_cond_broadcast(&g_batchCond);
+    pthread_mutex_unlock(&g_batchMutex);
+}
+
+/*
+ * Чтение запросов из fd построчно (read() кусками, без stdio) и выдача
+ * ответов. Ответ на запрос печатается, как только он готов и все более
+ * ранние уже напечатаны. Возвращает 0 или -1 при ошибке входа.
+ */
+static int batch_run(int fd) {
+    char buf[65536];
+    char line[BATCH_LINE_MAX];
+    size_t lineLen = 0;
+    long lineNo = 0;
+    int overflow = 0;
+
+    while (1) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0) {
+            write_str("Error reading batch input\n");
+            return -1;
+        }
+        for (ssize_t i = 0; i <= n; i++) {
+            // На конце входа последняя строка без '\n' — тоже строка
+            int eol = i < n ? buf[i] == '\n' : (n == 0 && lineLen > 0);
+            if (i < n && !eol) {
+                if (lineLen + 1 < sizeof(line)) {
+                    line[lineLen++] = buf[i];
+                } else {
+                    overflow = 1;
+                }
+                continue;
+            }
+            if (!eol) {
+                continue;
+            }
+
+            line[lineLen] = '\0';
+            lineNo++;
+            double radius;
+            long points;
+            int rc = overflow ? -1 : batch_parse(line, &radius, &points);
+            lineLen = 0;
+            overflow = 0;
+            if (rc < 0) {
+                write_str("Bad batch query at line ");
+                write_long(lineNo);
+                write_str(" (expected: radius [points])\n");
+                return -1;
+            }
+            if (rc > 0) {
+                batch_submit(radius, points);
+            }
+        }
+        if (n == 0) {
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&g_batchMutex);
+    atomic_store(&g_batchEof, 1);
+    pthread_cond_broadcast(&g_batchCond);
+    while (atomic_load(&g_batchOldest) != atomic_load(&g_batchPublished)) {
+        pthread_cond_wait(&g_batchCond, &g_batchMutex);
+    }
+    pthread_mutex_unlock(&g_batchMutex);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/*
+ * Отчёт --report/--affinity: по потоку и по узлу NUMA — сколько точек,
+ * сколько времени в задачах и простоя, сколько миллионов точек в секунду
+ * работы. Узел потока — тот, к которому он привязан, а без привязки —
+ * где он начал работу.
+ */
+static void print_report(long wallNs) {
+    long nodePoints[AFFINITY_MAX_NODES + 1] = {0};
+    long nodeBusy[AFFINITY_MAX_NODES + 1] = {0};
+    int nodeThreads[AFFINITY_MAX_NODES + 1] = {0};
+
+    for (int i = 0; i < g_workerCount; i++) {
+        const worker_t *w = &g_workers[i];
+        write_str("Thread ");
+        write_long(w->index);
+        write_str(": cpu ");
+        write_long(w->cpu);
+        write_str(", node ");
+        write_long(w->node);
+        write_str(", points ");
+        write_long(w->pointCount);
+        write_str(", busy ");
+        write_double((double) w->busyNs / 1e6, 3);
+        write_str(" ms, idle ");
+        write_double((double) (w->wallNs - w->busyNs) / 1e6, 3);
+        write_str(" ms, ");
+        write_double(w->busyNs > 0 ? (double) w->pointCount / ((double) w->busyNs / 1e3) : 0.0, 2);
+        write_str(" Mpoints/s\n");
+
+        // Узел -1 (неизвестен) копим в последней ячейке
+        int node = w->node >= 0 && w->node < AFFINITY_MAX_NODES ? w->node : AFFINITY_MAX_NODES;
+        nodePoints[node] += w->pointCount;
+        nodeBusy[node] += w->busyNs;
+        nodeThreads[node]++;
+    }
+
+    for (int node = 0; node <= AFFINITY_MAX_NODES; node++) {
+        if (nodeThreads[node] == 0) {
+            continue;
+        }
+        write_str("Node ");
+        write_long(node < AFFINITY_MAX_NODES ? node : -1);
+        write_str(": threads ");
+        write_long(nodeThreads[node]);
+        write_str(", points ");
+        write_long(nodePoints[node]);
+        write_str(", ");
+        write_double(nodeBusy[node] > 0 ? (double) nodePoints[node] / ((double) nodeBusy[node] / 1e3) : 0.0, 2);
+        write_str(" Mpoints/s per thread, ");
+        write_double(wallNs > 0 ? (double) nodePoints[node] / ((double) wallNs / 1e3) : 0.0, 2);
+        write_str(" Mpoints/s total\n");
+    }
+}
+
+//------------------------------------------------------------------------------
+// Запуск пула потоков и сбор результата (обычный режим, --batch, --bench)
+
+/*
+ * Запускает count потоков с телом body. Счётчики задач обнуляются, так что
+ * пул можно запускать снова (--bench); g_workers прошлого запуска
+ * освобождается здесь же. plan — процессоры по --affinity, planLength = 0 —
+ * без привязки.
+ */
+static pthread_t *start_workers(int count, void *(*body)(void *), const int *plan, int planLength) {
+    pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * count);
+    // aligned_alloc: выравнивание worker_t на линию кэша должно сохраниться и в куче
+    size_t workersBytes = sizeof(worker_t) * (size_t) count;
+    free(g_workers);
+    g_workers = (worker_t *) aligned_alloc(CACHE_LINE, workersBytes);
+    if (!threads || !g_workers) {
+        write_str("Memory allocation error\n");
+        _exit(1);
+    }
+
+    // 4) Инициализируем счётчики; в режиме кражи делим блоки на равные
+    //    диапазоны по потокам, дальше потоки выравнивают нагрузку сами
+    atomic_store(&g_nextBlock, 0);
+    atomic_store(&g_stop, 0);
+    for (int r = 0; r < QMC_REPLICAS; r++) {
+        atomic_store(&g_replicaHits[r], 0);
+        atomic_store(&g_replicaPoints[r], 0);
+    }
+    g_workerCount = count;
+    for (int i = 0; i < count; i++) {
+        uint32_t begin = (uint32_t) (g_totalBlocks * i / count);
+        uint32_t end = (uint32_t) (g_totalBlocks * (i + 1) / count);
+        atomic_init(&g_workers[i].range, range_pack(begin, end));
+        atomic_init(&g_workers[i].statBlocks, 0);
+        atomic_init(&g_workers[i].statHits, 0);
+        atomic_init(&g_workers[i].statHitsSq, 0.0);
+        g_workers[i].insideCount = 0;
+        g_workers[i].pointCount = 0;
+        g_workers[i].nsPerBlock = 0.0;
+        g_workers[i].busyNs = 0;
+        g_workers[i].wallNs = 0;
+        g_workers[i].index = i;
+        g_workers[i].cpu = planLength > 0 ? plan[i % planLength] : -1;
+        g_workers[i].node = planLength > 0 ? g_topology.nodeOf[g_workers[i].cpu] : -1;
+    }
+
+    // 5) Запускаем потоки. С --affinity поток создаётся уже привязанным:
+    //    он с первой инструкции работает на своём процессоре, и стек,
+    //    и всё, что он трогает первым, ложится в память его узла
+    for (int i = 0; i < count; i++) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if (planLength > 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(g_workers[i].cpu, &set);
+            pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        }
+        if (pthread_create(&threads[i], &attr, body, &g_workers[i]) != 0) {
+            write_str("pthread_create failed\n");
+            _exit(1);
+        }
+        pthread_attr_destroy(&attr);
+    }
+    return threads;
+}
+
+typedef struct {
+    long insideCount;
+    long pointCount;                  // При ранней остановке — сколько успели посчитать
+    long wallNs;                      // От start_workers до конца последнего потока
+    double area;
+    double stdError;                  // < 0 — оценить не по чему (QMC, блоков меньше, чем реплик)
+} run_result_t;
+
+// Дожидается потоков пула (threads освобождается) и сводит их счётчики
+static void finish_run(pthread_t *threads, long runStart, run_result_t *result) {
+    // 6) Дождёмся завершения всех потоков и сложим их счётчики
+    long insideCount = 0;
+    long pointCount = 0;
+    for (int i = 0; i < g_workerCount; i++) {
+        pthread_join(threads[i], NULL);
+        insideCount += g_workers[i].insideCount;
+        pointCount += g_workers[i].pointCount;
+    }
+    result->wallNs = now_ns() - runStart;
+    free(threads);
+
+    // Погрешность — по итогам всех блоков (при ранней остановке часть
+    // потоков могла досчитать задачи уже после проверки)
+    double area = 0.0, stdError = 0.0;
+    int haveError = estimate_error(&area, &stdError);
+
+    // 7) Вычислим оценку площади окружности методом Монте-Карло
+    //
+    //    Пояснение:
+    //    Площадь квадрата, в котором генерируем точки = 4 * R^2
+    //    (для других областей — объём их параллелепипеда).
+    //    Доля "попавших" внутрь круга точек = (число точек внутри / общее число точек).
+    //    => Площадь круга = доля * площадь квадрата = (inside / total) * 4 * R^2.
+    //    При ранней остановке total — сколько точек успели посчитать.
+    //
+    double fraction = (double) insideCount / (double) pointCount;
+    area = fraction * g_boxVolume;
+
+    //    Полных блоков мало для оценки по блокам — берём биномиальную
+    //    ошибку доли sqrt(p(1 - p) / n) (для независимых точек она точная).
+    //    Для QMC она неверна: там — по репликам, если точки есть у каждой
+    if (!haveError && g_qmc) {
+        if (!replica_error_global(&stdError)) {
+            stdError = -1.0;
+        }
+    } else if (!haveError) {
+        stdError = sqrt(fraction * (1.0 - fraction) / (double) pointCount) * g_boxVolume;
+    }
+
+    result->insideCount = insideCount;
+    result->pointCount = pointCount;
+    result->area = area;
+    result->stdError = stdError;
+}
+
+//------------------------------------------------------------------------------
+/*
+ * Замер масштабирования (--bench csv|json): тот же расчёт прогоняется для
+ * каждого числа потоков из --bench-threads и каждого размера задачи из
+ * --bench-chunks, по --bench-repeat раз; на каждый прогон — строка CSV или
+ * объект JSON на stdout:
+ *     threads, chunk        — число потоков и размер задачи в точках (auto);
+ *     points, wall_ms       — сколько точек посчитано и за сколько (от запуска
+ *                             потоков до конца последнего);
+ *     mpoints_per_s         — точек в секунду, в миллионах;
+ *     area, std_error       — оценка и её стандартная ошибка;
+ *     exact, abs_error, rel_error — точное значение (круг: pi*R^2, см.
+ *                             region_exact_volume()) и отклонение от него;
+ *                             для областей без формулы — пусто (null);
+ *     busy_ms_*, idle_ms_*  — время потоков в задачах и в простое (среднее,
+ *                             наибольший простой): рост простоя с числом
+ *                             потоков — признак плохой балансировки.
+ * В JSON у прогона есть ещё "workers" — то же по каждому потоку.
+ *
+ * Точки не зависят от раздачи блоков, поэтому при одном --points area во
+ * всех строках одна и та же — меняется только время. Повторы сглаживают
+ * шум (частота, соседи по машине); печать идёт между прогонами и в замер
+ * не входит.
+ */
+#define BENCH_MAX_LIST 64
+
+/*
+ * Список чисел через запятую (1e6 допускается); с allowAuto слово auto
+ * даёт 0. Возвращает длину или -1 при ошибке.
+ */
+static int bench_parse_list(const char *s, long *out, int max, int allowAuto) {
+    static char item[64];
+    int count = 0;
+    while (*s) {
+        size_t len = strcspn(s, ",");
+        if (len == 0 || len >= sizeof(item) || count == max) {
+            return -1;
+        }
+        memcpy(item, s, len);
+        item[len] = '\0';
+        long v = allowAuto && strcmp(item, "auto") == 0 ? 0 : parse_count(item);
+        if (v < 0 || (v == 0 && !(allowAuto && strcmp(item, "auto") == 0))) {
+            return -1;
+        }
+        out[count++] = v;
+        s += len;
+        if (*s == ',') {
+            s++;
+        }
+    }
+    return count;
+}
+
+// Строка JSON в кавычках; экранируем только то, что может встретиться в пути
+static void bench_write_json_string(const char *s) {
+    write_str("\"");
+    for (; *s; s++) {
+        char c[3] = {'\\', *s, '\0'};
+        write_str(*s == '"' || *s == '\\' ? c : c + 1);
+    }
+    write_str("\"");
+}
+
+static void bench_write_field(const char *name, int json) {
+    if (json) {
+        write_str(", \"");
+        write_str(name);
+        write_str("\": ");
+    } else {
+        write_str(",");
+    }
+}
+
+static void bench_write_row(const run_result_t *r, long chunkPoints, int repeat, double exact, int json) {
+    long busySum = 0, idleSum = 0, idleMax = 0;
+    for (int i = 0; i < g_workerCount; i++) {
+        long idle = g_workers[i].wallNs - g_workers[i].busyNs;
+        busySum += g_workers[i].busyNs;
+        idleSum += idle;
+        idleMax = idle > idleMax ? idle : idleMax;
+    }
+
+    if (json) {
+        write_str("    {\"threads\": ");
+    }
+    write_long(g_workerCount);
+    bench_write_field("chunk", json);
+    if (chunkPoints > 0) {
+        write_long(chunkPoints);
+    } else {
+        write_str(json ? "\"auto\"" : "auto");
+    }
+    bench_write_field("repeat", json);
+    write_long(repeat);
+    bench_write_field("points", json);
+    write_long(r->pointCount);
+    bench_write_field("wall_ms", json);
+    write_double((double) r->wallNs / 1e6, 3);
+    bench_write_field("mpoints_per_s", json);
+    write_double(r->wallNs > 0 ? (double) r->pointCount / ((double) r->wallNs / 1e3) : 0.0, 2);
+    bench_write_field("area", json);
+    write_double(r->area, 9);
+    bench_write_field("std_error", json);
+    if (r->stdError >= 0.0) {
+        write_double(r->stdError, 9);
+    } else {
+        write_str(json ? "null" : "");
+    }
+    bench_write_field("exact", json);
+    if (exact >= 0.0) {
+        write_double(exact, 9);
+        bench_write_field("abs_error", json);
+        write_double(fabs(r->area - exact), 9);
+        bench_write_field("rel_error", json);
+        write_double(fabs(r->area - exact) / exact, 9);
+    } else {
+        const char *none = json ? "null" : "";
+        write_str(none);
+        bench_write_field("abs_error", json);
+        write_str(none);
+        bench_write_field("rel_error", json);
+        write_str(none);
+    }
+    bench_write_field("busy_ms_mean", json);
+    write_double((double) busySum / g_workerCount / 1e6, 3);
+    bench_write_field("idle_ms_mean", json);
+    write_double((double) idleSum / g_workerCount / 1e6, 3);
+    bench_write_field("idle_ms_max", json);
+    write_double((double) idleMax / 1e6, 3);
+
+    if (json) {
+        write_str(",\n     \"workers\": [");
+        for (int i = 0; i < g_workerCount; i++) {
+            const worker_t *w = &g_workers[i];
+            write_str(i ? ", {\"cpu\": " : "{\"cpu\": ");
+            write_long(w->cpu);
+            write_str(", \"node\": ");
+            write_long(w->node);
+            write_str(", \"points\": ");
+            write_long(w->pointCount);
+            write_str(", \"busy_ms\": ");
+            write_double((double) w->busyNs / 1e6, 3);
+            write_str(", \"idle_ms\": ");
+            write_double((double) (w->wallNs - w->busyNs) / 1e6, 3);
+            write_str("}");
+        }
+        write_str("]}");
+    } else {
+        write_str("\n");
+    }
+}
+
+static void bench_run(const char *format, const long *threadCounts, int threadCountLength,
+                      const long *chunks, int chunkLength, int repeats,
+                      const char *kernelName, const char *regionSpec, const int *plan, int planLength) {
+    int json = strcmp(format, "json") == 0;
+    double exact = region_exact_volume(&g_region);
+
+    if (json) {
+        write_str("{\"kernel\": ");
+        bench_write_json_string(kernelName);
+        write_str(", \"sampler\": ");
+        bench_write_json_string(g_sampler);
+        write_str(", \"region\": ");
+        bench_write_json_string(regionSpec);
+        write_str(", \"radius\": ");
+        write_double(g_radius, 6);
+        write_str(", \"steal\": ");
+        write_str(g_steal ? "true" : "false");
+        write_str(",\n  \"runs\": [\n");
+    } else {
+        write_str("threads,chunk,repeat,points,wall_ms,mpoints_per_s,area,std_error,exact,abs_error,rel_error,"
+                  "busy_ms_mean,idle_ms_mean,idle_ms_max\n");
+    }
+
+    int rows = 0;
+    for (int t = 0; t < threadCountLength; t++) {
+        for (int c = 0; c < chunkLength; c++) {
+            g_chunkBlocks = (chunks[c] + BLOCK_POINTS - 1) / BLOCK_POINTS;
+            for (int rep = 0; rep < repeats; rep++) {
+                run_result_t result;
+                long runStart = now_ns();
+                pthread_t *threads = start_workers((int) threadCounts[t], thread_worker, plan, planLength);
+                finish_run(threads, runStart, &result);
+
+                if (json && rows++) {
+                    write_str(",\n");
+                }
+                bench_write_row(&result, g_chunkBlocks * BLOCK_POINTS, rep, exact, json);
+            }
+        }
+    }
+
+    if (json) {
+        write_str("\n  ]\n}\n");
+    }
+}
+
 //------------------------------------------------------------------------------
 // Точка входа в программу
 
@@ -207,7 +1298,11 @@ int main(int argc, char *argv[]) {
 
     if (argc < 3) {
 
-        write_str("Usage: ./lab2 <radius> <max_threads>\n");
+        write_str("Usage: ./lab2 <radius> <max_threads> [--points N] [--chunk N|auto] [--steal]"
+                  " [--target-se X[%] | --target-ci X[%]] [--sampler prng|sobol|halton]"
+                  " [--region circle|ellipse:A,B|polygon:X1,Y1,...|ball:N|plugin:PATH[:ARG]]"
+                  " [--affinity compact|scatter|CPU_LIST] [--report] [--batch FILE|-]"
+                  " [--bench csv|json [--bench-threads N,...] [--bench-chunks N|auto,...] [--bench-repeat N]]\n");
         _exit(1);
     }
 
@@ -225,54 +1320,256 @@ int main(int argc, char *argv[]) {
         _exit(1);
     }
 
+    const char *regionSpec = "circle";
+    const char *affinityMode = NULL;
+    int report = 0;
+    const char *batchPath = NULL;
+    const char *benchFormat = NULL;
+    static long benchThreads[BENCH_MAX_LIST];
+    static long benchChunks[BENCH_MAX_LIST];
+    int benchThreadCount = 0;
+    int benchChunkCount = 0;
+    int benchRepeat = 3;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--steal") == 0) {
+            g_steal = 1;
+        } else if (strcmp(argv[i], "--points") == 0 && i + 1 < argc) {
+            g_totalPoints = parse_count(argv[++i]);
+            if (g_totalPoints <= 0) {
+                write_str("--points must be a positive integer!\n");
+                _exit(1);
+            }
+        } else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "auto") == 0) {
+                g_chunkBlocks = 0;
+            } else {
+                long chunk = parse_count(argv[i]);
+                if (chunk <= 0) {
+                    write_str("--chunk must be a positive integer or auto!\n");
+                    _exit(1);
+                }
+                g_chunkBlocks = (chunk + BLOCK_POINTS - 1) / BLOCK_POINTS;
+            }
+        } else if ((strcmp(argv[i], "--target-se") == 0 || strcmp(argv[i], "--target-ci") == 0) && i + 1 < argc) {
+            int ci = strcmp(argv[i], "--target-ci") == 0;
+            if (!parse_target(argv[++i])) {
+                write_str("--target-se/--target-ci must be a positive number, optionally with %!\n");
+                _exit(1);
+            }
+            if (ci) {
+                // Полуширина интервала = z * ошибка: сведём к ошибке
+                g_target /= TARGET_CI_Z;
+            }
+        } else if (strcmp(argv[i], "--sampler") == 0 && i + 1 < argc) {
+            g_sampler = argv[++i];
+            if (strcmp(g_sampler, "prng") != 0 && strcmp(g_sampler, "sobol") != 0
+                && strcmp(g_sampler, "halton") != 0) {
+                write_str("--sampler must be prng, sobol or halton!\n");
+                _exit(1);
+            }
+        } else if (strcmp(argv[i], "--region") == 0 && i + 1 < argc) {
+            regionSpec = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batchPath = argv[++i];
+        } else if (strcmp(argv[i], "--affinity") == 0 && i + 1 < argc) {
+            affinityMode = argv[++i];
+            report = 1;
+        } else if (strcmp(argv[i], "--report") == 0) {
+            report = 1;
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            benchFormat = argv[++i];
+            if (strcmp(benchFormat, "csv") != 0 && strcmp(benchFormat, "json") != 0) {
+                write_str("--bench must be csv or json!\n");
+                _exit(1);
+            }
+        } else if (strcmp(argv[i], "--bench-threads") == 0 && i + 1 < argc) {
+            benchThreadCount = bench_parse_list(argv[++i], benchThreads, BENCH_MAX_LIST, 0);
+            if (benchThreadCount <= 0) {
+                write_str("--bench-threads must be a list of positive integers!\n");
+                _exit(1);
+            }
+        } else if (strcmp(argv[i], "--bench-chunks") == 0 && i + 1 < argc) {
+            benchChunkCount = bench_parse_list(argv[++i], benchChunks, BENCH_MAX_LIST, 1);
+            if (benchChunkCount <= 0) {
+                write_str("--bench-chunks must be a list of positive integers or auto!\n");
+                _exit(1);
+            }
+        } else if (strcmp(argv[i], "--bench-repeat") == 0 && i + 1 < argc) {
+            benchRepeat = atoi(argv[++i]);
+            if (benchRepeat <= 0) {
+                write_str("--bench-repeat must be positive!\n");
+                _exit(1);
+            }
+        } else {
+            write_str("Unknown option: ");
+            write_str(argv[i]);
+            write_str("\n");
+            _exit(1);
+        }
+    }
 
 
-    g_totalTasks = (int) (TOTAL_POINTS / CHUNK_SIZE);
-
 
+    g_totalBlocks = (g_totalPoints + BLOCK_POINTS - 1) / BLOCK_POINTS;
+    if (g_totalBlocks > (long) UINT32_MAX) {
+        // Диапазоны краж хранят номера блоков в 32 битах
+        write_str("--points is too large!\n");
+        _exit(1);
+    }
 
-    pthread_t *threads = (pthread_t *) malloc(sizeof(pthread_t) * maxThreads);
-    if (!threads) {
-        write_str("Memory allocation error\n");
+    const char *regionError = region_parse(regionSpec, g_radius);
+    if (regionError) {
+        write_str("--region: ");
+        write_str(regionError);
+        write_str("\n");
+        _exit(1);
+    }
+    g_boxVolume = region_box_volume(&g_region);
+    if (g_region.kind != REGION_CIRCLE && strcmp(g_sampler, "prng") != 0) {
+        write_str("--sampler sobol/halton is only supported for the circle!\n");
         _exit(1);
     }
 
-    // 4) Инициализируем g_insideCount = 0, g_nextTask = 0
-    g_insideCount = 0;
-    g_nextTask = 0;
+    // --bench без списков: потоки 1, 2, 4, ... до maxThreads; размер задачи — из --chunk
+    if (benchFormat) {
+        if (batchPath) {
+            write_str("--bench cannot be combined with --batch!\n");
+            _exit(1);
+        }
+        if (benchThreadCount == 0) {
+            for (long n = 1; n < maxThreads && benchThreadCount < BENCH_MAX_LIST - 1; n *= 2) {
+                benchThreads[benchThreadCount++] = n;
+            }
+            benchThreads[benchThreadCount++] = maxThreads;
+        }
+        if (benchChunkCount == 0) {
+            benchChunks[benchChunkCount++] = g_chunkBlocks * BLOCK_POINTS;
+        }
+    }
 
-    // 5) Запускаем maxThreads потоков
-    for (int i = 0; i < maxThreads; i++) {
-        pthread_create(&threads[i], NULL, thread_worker, NULL);
+    int batchFd = -1;
+    if (batchPath) {
+        // Запросы — только круг (радиус в каждом свой) и общая очередь
+        if (g_steal || g_target > 0.0 || g_region.kind != REGION_CIRCLE) {
+            write_str("--batch cannot be combined with --steal, --target-* or --region!\n");
+            _exit(1);
+        }
+        batchFd = strcmp(batchPath, "-") == 0 ? STDIN_FILENO : open(batchPath, O_RDONLY);
+        if (batchFd < 0) {
+            write_str("Cannot open batch file: ");
+            write_str(batchPath);
+            write_str("\n");
+            _exit(1);
+        }
     }
 
-    // 6) Дождёмся завершения всех потоков
-    for (int i = 0; i < maxThreads; i++) {
-        pthread_join(threads[i], NULL);
+    // Процессоры для --affinity: план раздачи по потокам
+    static int plan[AFFINITY_MAX_CPUS];
+    int planLength = 0;
+    affinity_topology(&g_topology);
+    if (affinityMode) {
+        planLength = affinity_plan(&g_topology, affinityMode, plan);
+        if (planLength == 0) {
+            write_str("--affinity must be compact, scatter or a list of allowed CPUs!\n");
+            _exit(1);
+        }
     }
 
-    // Освобождаем память
-    free(threads);
+    // Ядро выбираем один раз, до запуска потоков
+    const char *kernelName;
+    g_kernel = kernel_select(&kernelName);
+    if (g_region.kind != REGION_CIRCLE) {
+        g_kernel = region_kernel();
+        kernelName = "scalar";
+    }
+    g_qmc = strcmp(g_sampler, "prng") != 0;
+    if (strcmp(g_sampler, "sobol") == 0) {
+        if (g_totalPoints / QMC_REPLICAS > QMC_SOBOL_MAX_POINTS) {
+            write_str("--sampler sobol supports at most 2^32 points per replica!\n");
+            _exit(1);
+        }
+        qmc_sobol_init(g_seed);
+        g_kernel = qmc_sobol_kernel;
+        kernelName = "sobol (scalar)";
+    } else if (strcmp(g_sampler, "halton") == 0) {
+        qmc_halton_init(g_seed);
+        g_kernel = qmc_halton_kernel;
+        kernelName = "halton (scalar)";
+    }
 
-    // 7) Вычислим оценку площади окружности методом Монте-Карло
-    //
-    //    Пояснение:
-    //    Площадь квадрата, в котором генерируем точки = 4 * R^2.
-    //    Доля "попавших" внутрь круга точек = (число точек внутри / общее число точек).
-    //    => Площадь круга = доля * площадь квадрата = (inside / total) * 4 * R^2.
-    //
-    double fraction = (double) g_insideCount / (double) TOTAL_POINTS;
-    double area = fraction * 4.0 * (g_radius * g_radius);
+
+
+    // Замер масштабирования: свои прогоны и свой вывод
+    if (benchFormat) {
+        bench_run(benchFormat, benchThreads, benchThreadCount, benchChunks, benchChunkCount, benchRepeat,
+                  kernelName, regionSpec, plan, planLength);
+        free(g_workers);
+        _exit(0);
+    }
+
+    // 4)-5) Запускаем пул из maxThreads потоков
+    long runStart = now_ns();
+    pthread_t *threads = start_workers(maxThreads, batchFd >= 0 ? batch_worker : thread_worker, plan, planLength);
+
+    // Пакетный режим: main читает запросы, пул отвечает; потоки
+    // завершатся сами, когда вход кончится и все запросы будут отвечены
+    if (batchFd >= 0) {
+        if (batch_run(batchFd) != 0) {
+            _exit(1);
+        }
+        for (int i = 0; i < maxThreads; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        if (report) {
+            print_report(now_ns() - runStart);
+        }
+        _exit(0);
+    }
+
+    // 6)-7) Дождёмся потоков и сведём их счётчики в оценку площади
+    run_result_t result;
+    finish_run(threads, runStart, &result);
+    double area = result.area;
+    double stdError = result.stdError;
+    long pointCount = result.pointCount;
 
     // 8) Вывод результата (без printf)
     // Сконвертируем area в строку и выведем
     char bufArea[128];
     my_dtoa(area, bufArea, 6); // 6 знаков после запятой
 
-    write_str("Calculated area = ");
+    write_str("Kernel: ");
+    write_str(kernelName);
+    write_str("\n");
+    write_str(g_region.dim == 2 ? "Calculated area = " : "Calculated volume = ");
     write_str(bufArea);
     write_str("\n");
 
+    char buf[64];
+    write_str("Std. error = ");
+    if (stdError >= 0.0) {
+        my_dtoa(stdError, buf, 9);
+        write_str(buf);
+    } else {
+        write_str("n/a (fewer blocks than QMC replicas)");
+    }
+    write_str("\n");
+
+    if (g_target > 0.0) {
+        my_itoa(pointCount, buf);
+        write_str("Points used = ");
+        write_str(buf);
+        write_str("\n");
+    }
+
+    if (report) {
+        print_report(result.wallNs);
+    }
+
+    // Освобождаем память
+    free(g_workers);
+
     // 9) Завершение
     _exit(0);
 }
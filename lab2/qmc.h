@@ -0,0 +1,208 @@
+#ifndef LAB2_QMC_H
+#define LAB2_QMC_H
+
+/*
+ * Квази-Монте-Карло: вместо случайных точек — последовательности с низким
+ * расхождением (Соболь, Холтон). Они заполняют квадрат равномернее
+ * случайных, и ошибка убывает почти как 1/N, а не как 1/sqrt(N).
+ *
+ * Точка последовательности определяется только своим номером, поэтому
+ * последовательность режется на задачи так же, как поток ГПСЧ. Сигнатуры
+ * ядер те же, что в kernel.h.
+ *
+ * Рандомизированный QMC: последовательность не одна, а QMC_REPLICAS
+ * независимо рандомизированных копий (реплик). Блоки раздаются репликам по
+ * кругу: блок block — это блок номер block / QMC_REPLICAS реплики
+ * block % QMC_REPLICAS, с точками [номер * KERNEL_BLOCK_POINTS, ...) её
+ * последовательности. Оценка каждой реплики несмещённая, реплики
+ * независимы, поэтому погрешность среднего честно оценивается по разбросу
+ * их оценок (см. main.c). Разброс по блокам одной последовательности для
+ * этого не годится: блоки зависимы, и такая оценка завышена во много раз.
+ * Цена — в sqrt(QMC_REPLICAS) раз большая ошибка, чем у одной
+ * последовательности той же длины; порядок убывания ~1/N сохраняется.
+ *
+ * Соболь — 32-битный, в порядке кода Грея: следующая точка получается из
+ * предыдущей одним XOR, а в начале блока точка считается напрямую по
+ * номеру. Перемешивание — вложенное по Оуэну в варианте Burley (2020,
+ * хеш Laine-Karras по перевёрнутым битам): своя случайная перестановка
+ * у каждой реплики (из зерна), свойства последовательности сохраняются,
+ * а каждая точка равномерно распределена в квадрате.
+ * Точки храним сразу с перевёрнутыми битами (направляющие числа
+ * перевёрнуты заранее) — на координату остаётся один переворот, а не два.
+ * Номеров у 32-битного Соболя 2^32 (QMC_SOBOL_MAX_POINTS) на реплику,
+ * дальше точки повторяются.
+ *
+ * Холтон — основания 2 и 3, номера с 1, чтобы не брать вершину квадрата
+ * (0, 0). Рандомизация — случайный сдвиг по модулю 1 (Cranley-Patterson),
+ * свой у каждой реплики. Троичная координата номера n = hi * 3^10 + lo —
+ * это phi(lo) + phi(hi) / 3^10: phi(lo) берём из таблицы на 3^10 значений,
+ * phi(hi) пересчитываем раз в 3^10 точек.
+ */
+
+#include <stdint.h>
+
+#include "rng.h"
+#include "kernel.h"
+
+#define QMC_REPLICAS 16
+#define QMC_SOBOL_MAX_POINTS (1L << 32)
+#define QMC_HALTON_LOW 59049      // 3^10: размер таблицы младших троичных цифр
+
+// Реплика блока и номер блока внутри её последовательности
+static inline unsigned qmc_replica(uint64_t block) {
+    return (unsigned) (block % QMC_REPLICAS);
+}
+
+static inline uint64_t qmc_replica_block(uint64_t block) {
+    return block / QMC_REPLICAS;
+}
+
+//------------------------------------------------------------------------------
+// Соболь
+
+/*
+ * Направляющие числа двух первых измерений: первое — ван дер Корпут
+ * (1 << (31 - k)), второе — многочлен x + 1, v_k = v_{k-1} ^ (v_{k-1} >> 1).
+ * Хранятся с перевёрнутыми битами.
+ */
+typedef struct {
+    uint32_t v[2][32];
+    uint32_t scramble[QMC_REPLICAS][2]; // зёрна перестановки Оуэна: реплика, измерение
+} qmc_sobol_t;
+
+static qmc_sobol_t g_qmcSobol;
+
+static inline uint32_t qmc_reverse32(uint32_t x) {
+    x = __builtin_bswap32(x);
+    x = ((x & 0x0F0F0F0Fu) << 4) | ((x >> 4) & 0x0F0F0F0Fu);
+    x = ((x & 0x33333333u) << 2) | ((x >> 2) & 0x33333333u);
+    x = ((x & 0x55555555u) << 1) | ((x >> 1) & 0x55555555u);
+    return x;
+}
+
+// Принимает и возвращает координату с перевёрнутыми битами
+static inline uint32_t qmc_owen_scramble_reversed(uint32_t x, uint32_t seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+// Вызывается один раз до запуска потоков
+static inline void qmc_sobol_init(uint64_t seed) {
+    uint32_t v = 1u << 31;
+    for (int k = 0; k < 32; k++) {
+        g_qmcSobol.v[0][k] = 1u << k;
+        g_qmcSobol.v[1][k] = qmc_reverse32(v);
+        v ^= v >> 1;
+    }
+    uint64_t x = seed;
+    for (int r = 0; r < QMC_REPLICAS; r++) {
+        g_qmcSobol.scramble[r][0] = (uint32_t) rng_splitmix64(&x);
+        g_qmcSobol.scramble[r][1] = (uint32_t) rng_splitmix64(&x);
+    }
+}
+
+static inline double qmc_u32_to_coord(uint32_t x) {
+    // [0, 2^32) -> [-1, 1) точно, без округления
+    return (double) x * 0x1p-31 - 1.0;
+}
+
+static long qmc_sobol_kernel(uint64_t seed, uint64_t block, long points) {
+    (void) seed; // перестановки уже выбраны в qmc_sobol_init()
+    const qmc_sobol_t *q = &g_qmcSobol;
+    const uint32_t *scramble = q->scramble[qmc_replica(block)];
+    uint32_t index = (uint32_t) (qmc_replica_block(block) * KERNEL_BLOCK_POINTS);
+
+    // Точка номер index в порядке Грея — XOR направляющих по битам gray(index)
+    uint32_t gray = index ^ (index >> 1);
+    uint32_t x = 0, y = 0;
+    for (int k = 0; gray; k++, gray >>= 1) {
+        if (gray & 1u) {
+            x ^= q->v[0][k];
+            y ^= q->v[1][k];
+        }
+    }
+
+    long inside = 0;
+    for (long k = 0; k < points; k++) {
+        double px = qmc_u32_to_coord(qmc_reverse32(qmc_owen_scramble_reversed(x, scramble[0])));
+        double py = qmc_u32_to_coord(qmc_reverse32(qmc_owen_scramble_reversed(y, scramble[1])));
+        inside += (px * px + py * py <= 1.0);
+
+        // Следующая точка: меняется одно направляющее число — с номером,
+        // равным числу младших нулей index+1 (index = 0 — конец последовательности)
+        index++;
+        if (index) {
+            int bit = __builtin_ctz(index);
+            x ^= q->v[0][bit];
+            y ^= q->v[1][bit];
+        }
+    }
+    return inside;
+}
+
+//------------------------------------------------------------------------------
+// Холтон
+
+static double g_qmcHaltonLow[QMC_HALTON_LOW];
+
+// Сдвиги реплик: по основанию 2 — 53-битное целое (координата там и так
+// целая), по основанию 3 — доля единицы
+static uint64_t g_qmcHaltonShiftX[QMC_REPLICAS];
+static double g_qmcHaltonShiftY[QMC_REPLICAS];
+
+// Троичная обратная запись n: цифры задом наперёд после запятой
+static inline double qmc_radical_inverse3(uint64_t n) {
+    double value = 0.0;
+    double f = 1.0 / 3.0;
+    while (n) {
+        value += f * (double) (n % 3);
+        n /= 3;
+        f *= 1.0 / 3.0;
+    }
+    return value;
+}
+
+// Вызывается один раз до запуска потоков
+static inline void qmc_halton_init(uint64_t seed) {
+    for (uint64_t n = 0; n < QMC_HALTON_LOW; n++) {
+        g_qmcHaltonLow[n] = qmc_radical_inverse3(n);
+    }
+    uint64_t x = seed;
+    for (int r = 0; r < QMC_REPLICAS; r++) {
+        g_qmcHaltonShiftX[r] = rng_splitmix64(&x) >> 11;
+        g_qmcHaltonShiftY[r] = (double) (rng_splitmix64(&x) >> 11) * 0x1p-53;
+    }
+}
+
+static long qmc_halton_kernel(uint64_t seed, uint64_t block, long points) {
+    (void) seed; // сдвиги уже выбраны в qmc_halton_init()
+    unsigned replica = qmc_replica(block);
+    uint64_t shiftX = g_qmcHaltonShiftX[replica];
+    double shiftY = g_qmcHaltonShiftY[replica];
+    uint64_t index = qmc_replica_block(block) * (uint64_t) KERNEL_BLOCK_POINTS + 1;
+    uint64_t hi = index / QMC_HALTON_LOW;
+    uint32_t lo = (uint32_t) (index % QMC_HALTON_LOW);
+    double high = qmc_radical_inverse3(hi) / QMC_HALTON_LOW;
+
+    long inside = 0;
+    for (long k = 0; k < points; k++, index++) {
+        // Основание 2: биты номера задом наперёд после запятой (старшие 53)
+        uint64_t reversed = (uint64_t) qmc_reverse32((uint32_t) index) << 32 | qmc_reverse32((uint32_t) (index >> 32));
+        double px = (double) (((reversed >> 11) + shiftX) & ((1ull << 53) - 1)) * 0x1p-53 * 2.0 - 1.0;
+        double y = g_qmcHaltonLow[lo] + high + shiftY;
+        double py = (y < 1.0 ? y : y - 1.0) * 2.0 - 1.0;
+        inside += (px * px + py * py <= 1.0);
+
+        if (++lo == QMC_HALTON_LOW) {
+            lo = 0;
+            high = qmc_radical_inverse3(++hi) / QMC_HALTON_LOW;
+        }
+    }
+    return inside;
+}
+
+#endif // LAB2_QMC_H
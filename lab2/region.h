@@ -0,0 +1,315 @@
+#ifndef LAB2_REGION_H
+#define LAB2_REGION_H
+
+/*
+ * Области интегрирования: что именно меряет Монте-Карло.
+ *
+ * Область — это ограничивающий параллелепипед [lo, hi] размерности dim и
+ * предикат "точка внутри". Точки равномерно бросаются в параллелепипед,
+ * объём области = объём параллелепипеда * доля попаданий.
+ *
+ * Частые формы (эллипс, многоугольник, N-мерный шар) встроены: для каждой
+ * макрос REGION_DEFINE_KERNEL порождает своё ядро блока с подставленным
+ * предикатом, так что во внутреннем цикле нет вызовов по указателю. Круг —
+ * отдельный случай, его считают векторные ядра kernel.h. Остальное —
+ * через модуль (.so), который main подгружает dlopen'ом, как аллокаторы
+ * в lab4; модуль экспортирует:
+ *
+ *     int region_init(const char *arg, int *dim, double *lo, double *hi);
+ *         разобрать arg (всё после "plugin:путь:"), заполнить размерность
+ *         (не больше REGION_MAX_DIM) и параллелепипед; 0 — успех;
+ *     int region_inside(const double *x, int dim);
+ *         не 0, если точка x внутри области.
+ *
+ * Пример модуля — region_annulus.c.
+ *
+ * Ядра областей берут один поток ГПСЧ на блок (rng_seed(seed, block)), так
+ * что результат, как и для круга, не зависит от раздачи блоков потокам.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dlfcn.h>
+
+#include "rng.h"
+#include "kernel.h"
+
+#define REGION_MAX_DIM 16
+#define REGION_MAX_VERTICES 256
+
+typedef enum {
+    REGION_CIRCLE,
+    REGION_ELLIPSE,
+    REGION_POLYGON,
+    REGION_BALL,
+    REGION_PLUGIN
+} region_kind_t;
+
+typedef struct {
+    region_kind_t kind;
+    int dim;
+    double lo[REGION_MAX_DIM];     // ограничивающий параллелепипед
+    double hi[REGION_MAX_DIM];
+
+    double radius2;                // шар: R^2
+    double invAxis2[2];            // эллипс: 1/a^2, 1/b^2
+    int vertices;                  // многоугольник: вершины по порядку обхода
+    double vx[REGION_MAX_VERTICES];
+    double vy[REGION_MAX_VERTICES];
+    double slope[REGION_MAX_VERTICES]; // dx/dy стороны (i-1, i), чтобы не делить в цикле
+    int (*inside)(const double *x, int dim); // модуль
+} region_t;
+
+static region_t g_region;
+
+// Объём ограничивающего параллелепипеда
+static inline double region_box_volume(const region_t *rg) {
+    double volume = 1.0;
+    for (int d = 0; d < rg->dim; d++) {
+        volume *= rg->hi[d] - rg->lo[d];
+    }
+    return volume;
+}
+
+/*
+ * Точный объём области, если он известен в замкнутом виде (для проверки
+ * точности в --bench): круг и эллипс — pi*a*b, шар — pi^(n/2) / Г(n/2 + 1) * R^n.
+ * Многоугольник (самопересечения возможны) и модули — -1, неизвестен.
+ */
+static inline double region_exact_volume(const region_t *rg) {
+    switch (rg->kind) {
+        case REGION_CIRCLE:
+            return M_PI * rg->radius2;
+        case REGION_ELLIPSE:
+            return M_PI / sqrt(rg->invAxis2[0] * rg->invAxis2[1]);
+        case REGION_BALL:
+            return pow(M_PI * rg->radius2, rg->dim / 2.0) / tgamma(rg->dim / 2.0 + 1.0);
+        default:
+            return -1.0;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Предикаты встроенных областей
+
+static inline int region_inside_ellipse(const region_t *rg, const double *x) {
+    return x[0] * x[0] * rg->invAxis2[0] + x[1] * x[1] * rg->invAxis2[1] <= 1.0;
+}
+
+static inline int region_inside_ball(const region_t *rg, const double *x) {
+    double dist2 = 0.0;
+    for (int d = 0; d < rg->dim; d++) {
+        dist2 += x[d] * x[d];
+    }
+    return dist2 <= rg->radius2;
+}
+
+// Чётно-нечётное правило: считаем пересечения луча вправо от точки со сторонами
+static inline int region_inside_polygon(const region_t *rg, const double *x) {
+    // Без ветвлений: для случайных точек исход сравнений непредсказуем
+    int inside = 0;
+    for (int i = 0, j = rg->vertices - 1; i < rg->vertices; j = i++) {
+        int spans = (rg->vy[i] > x[1]) != (rg->vy[j] > x[1]);
+        int left = x[0] < rg->slope[i] * (x[1] - rg->vy[i]) + rg->vx[i];
+        inside ^= spans & left;
+    }
+    return inside;
+}
+
+static inline int region_inside_plugin(const region_t *rg, const double *x) {
+    return rg->inside(x, rg->dim) != 0;
+}
+
+//------------------------------------------------------------------------------
+// Ядра блоков: та же сигнатура, что у kernel_fn. dim — размерность
+// выражением: для плоских областей это константа 2, и цикл по
+// координатам компилятор разворачивает.
+
+#define REGION_DEFINE_KERNEL(name, predicate, dim)                             \
+    static long name(uint64_t seed, uint64_t block, long points) {             \
+        const region_t *rg = &g_region;                                        \
+        double lo[REGION_MAX_DIM];                                             \
+        double span[REGION_MAX_DIM];                                           \
+        double x[REGION_MAX_DIM];                                              \
+        for (int d = 0; d < (dim); d++) {                                      \
+            lo[d] = rg->lo[d];                                                 \
+            span[d] = rg->hi[d] - rg->lo[d];                                   \
+        }                                                                      \
+        rng_t rng;                                                             \
+        rng_seed(&rng, seed, block);                                           \
+        long inside = 0;                                                       \
+        for (long k = 0; k < points; k++) {                                    \
+            for (int d = 0; d < (dim); d++) {                                  \
+                x[d] = lo[d] + rng_next_double(&rng) * span[d];                \
+            }                                                                  \
+            inside += predicate(rg, x);                                        \
+        }                                                                      \
+        return inside;                                                         \
+    }
+
+REGION_DEFINE_KERNEL(region_kernel_ellipse, region_inside_ellipse, 2)
+REGION_DEFINE_KERNEL(region_kernel_polygon, region_inside_polygon, 2)
+REGION_DEFINE_KERNEL(region_kernel_ball, region_inside_ball, rg->dim)
+REGION_DEFINE_KERNEL(region_kernel_plugin, region_inside_plugin, rg->dim)
+
+//------------------------------------------------------------------------------
+// Разбор --region
+
+// Числа через запятую; возвращает их количество или -1 при ошибке
+static inline int region_parse_numbers(const char *s, double *out, int max) {
+    int count = 0;
+    while (*s) {
+        char *end;
+        double v = strtod(s, &end);
+        if (end == s || count == max || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        out[count++] = v;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+/*
+ * Заполнить g_region по описанию:
+ *     circle               круг радиуса radius (по умолчанию);
+ *     ellipse:A,B          эллипс с полуосями A и B;
+ *     polygon:X1,Y1,X2,Y2,... многоугольник; самопересечения допустимы,
+ *                          внутренность — по правилу чёт-нечет;
+ *     ball:N               N-мерный шар радиуса radius;
+ *     plugin:ПУТЬ[:АРГ]    область из модуля.
+ * Возвращает NULL или текст ошибки.
+ */
+static const char *region_parse(const char *spec, double radius) {
+    region_t *rg = &g_region;
+    memset(rg, 0, sizeof(*rg));
+
+    if (strcmp(spec, "circle") == 0) {
+        rg->kind = REGION_CIRCLE;
+        rg->dim = 2;
+        rg->radius2 = radius * radius;
+        for (int d = 0; d < 2; d++) {
+            rg->lo[d] = -radius;
+            rg->hi[d] = radius;
+        }
+        return NULL;
+    }
+
+    if (strncmp(spec, "ellipse:", 8) == 0) {
+        double axes[2];
+        if (region_parse_numbers(spec + 8, axes, 2) != 2 || !(axes[0] > 0.0) || !(axes[1] > 0.0)) {
+            return "ellipse needs two positive semi-axes: ellipse:A,B";
+        }
+        rg->kind = REGION_ELLIPSE;
+        rg->dim = 2;
+        for (int d = 0; d < 2; d++) {
+            rg->invAxis2[d] = 1.0 / (axes[d] * axes[d]);
+            rg->lo[d] = -axes[d];
+            rg->hi[d] = axes[d];
+        }
+        return NULL;
+    }
+
+    if (strncmp(spec, "polygon:", 8) == 0) {
+        double coords[2 * REGION_MAX_VERTICES];
+        int n = region_parse_numbers(spec + 8, coords, 2 * REGION_MAX_VERTICES);
+        if (n < 6 || n % 2 != 0) {
+            return "polygon needs at least 3 vertices: polygon:X1,Y1,X2,Y2,X3,Y3,...";
+        }
+        rg->kind = REGION_POLYGON;
+        rg->dim = 2;
+        rg->vertices = n / 2;
+        rg->lo[0] = rg->hi[0] = coords[0];
+        rg->lo[1] = rg->hi[1] = coords[1];
+        for (int i = 0; i < rg->vertices; i++) {
+            rg->vx[i] = coords[2 * i];
+            rg->vy[i] = coords[2 * i + 1];
+            rg->lo[0] = rg->vx[i] < rg->lo[0] ? rg->vx[i] : rg->lo[0];
+            rg->hi[0] = rg->vx[i] > rg->hi[0] ? rg->vx[i] : rg->hi[0];
+            rg->lo[1] = rg->vy[i] < rg->lo[1] ? rg->vy[i] : rg->lo[1];
+            rg->hi[1] = rg->vy[i] > rg->hi[1] ? rg->vy[i] : rg->hi[1];
+        }
+        if (!(rg->hi[0] > rg->lo[0]) || !(rg->hi[1] > rg->lo[1])) {
+            return "polygon is degenerate";
+        }
+        // Горизонтальные стороны предикат пропускает, их наклон не нужен
+        for (int i = 0, j = rg->vertices - 1; i < rg->vertices; j = i++) {
+            double dy = rg->vy[j] - rg->vy[i];
+            rg->slope[i] = dy != 0.0 ? (rg->vx[j] - rg->vx[i]) / dy : 0.0;
+        }
+        return NULL;
+    }
+
+    if (strncmp(spec, "ball:", 5) == 0) {
+        double n;
+        if (region_parse_numbers(spec + 5, &n, 1) != 1 || n < 1 || n > REGION_MAX_DIM || n != (int) n) {
+            return "ball needs a dimension from 1 to 16: ball:N";
+        }
+        rg->kind = REGION_BALL;
+        rg->dim = (int) n;
+        rg->radius2 = radius * radius;
+        for (int d = 0; d < rg->dim; d++) {
+            rg->lo[d] = -radius;
+            rg->hi[d] = radius;
+        }
+        return NULL;
+    }
+
+    if (strncmp(spec, "plugin:", 7) == 0) {
+        // Путь и аргумент модуля разделены первым ':' после пути
+        static char path[4096];
+        const char *arg = strchr(spec + 7, ':');
+        size_t len = arg ? (size_t) (arg - (spec + 7)) : strlen(spec + 7);
+        if (len == 0 || len >= sizeof(path)) {
+            return "plugin needs a library path: plugin:PATH[:ARG]";
+        }
+        memcpy(path, spec + 7, len);
+        path[len] = '\0';
+
+        void *handle = dlopen(path, RTLD_NOW);
+        if (!handle) {
+            return dlerror();
+        }
+        int (*init)(const char *, int *, double *, double *) =
+                (int (*)(const char *, int *, double *, double *)) dlsym(handle, "region_init");
+        rg->inside = (int (*)(const double *, int)) dlsym(handle, "region_inside");
+        if (!init || !rg->inside) {
+            return "plugin must export region_init and region_inside";
+        }
+        rg->kind = REGION_PLUGIN;
+        if (init(arg ? arg + 1 : "", &rg->dim, rg->lo, rg->hi) != 0) {
+            return "plugin rejected its argument";
+        }
+        if (rg->dim < 1 || rg->dim > REGION_MAX_DIM) {
+            return "plugin dimension must be from 1 to 16";
+        }
+        for (int d = 0; d < rg->dim; d++) {
+            if (!(rg->hi[d] > rg->lo[d])) {
+                return "plugin bounding box is empty";
+            }
+        }
+        return NULL;
+    }
+
+    return "unknown region (circle, ellipse:A,B, polygon:..., ball:N, plugin:PATH[:ARG])";
+}
+
+// Ядро для области, кроме круга (у него свои векторные ядра)
+static inline kernel_fn region_kernel(void) {
+    switch (g_region.kind) {
+        case REGION_ELLIPSE:
+            return region_kernel_ellipse;
+        case REGION_POLYGON:
+            return region_kernel_polygon;
+        case REGION_BALL:
+            return region_kernel_ball;
+        case REGION_PLUGIN:
+            return region_kernel_plugin;
+        default:
+            return NULL;
+    }
+}
+
+#endif // LAB2_REGION_H
@@ -0,0 +1,47 @@
+/******************************************************************************
+ * Пример модуля области для lab2 (--region plugin:...): кольцо между
+ * окружностями радиусов R1 < R2.
+ *
+ * Сборка и запуск:
+ *     gcc -O2 -shared -fPIC -o region_annulus.so region_annulus.c
+ *     ./lab2 1 4 --region plugin:./region_annulus.so:1,2
+ *  площадь должна выйти около pi * (2^2 - 1^2) = 9.42.
+ ******************************************************************************/
+
+#include <stdlib.h>
+
+static double g_inner2 = 0.25;
+static double g_outer2 = 1.0;
+
+int region_init(const char *arg, int *dim, double *lo, double *hi) {
+    char *end;
+    double inner = 0.5, outer = 1.0;
+    if (*arg) {
+        inner = strtod(arg, &end);
+        if (*end != ',') {
+            return -1;
+        }
+        outer = strtod(end + 1, &end);
+        if (*end != '\0') {
+            return -1;
+        }
+    }
+    if (!(inner >= 0.0) || !(outer > inner)) {
+        return -1;
+    }
+
+    g_inner2 = inner * inner;
+    g_outer2 = outer * outer;
+    *dim = 2;
+    for (int d = 0; d < 2; d++) {
+        lo[d] = -outer;
+        hi[d] = outer;
+    }
+    return 0;
+}
+
+int region_inside(const double *x, int dim) {
+    (void) dim;
+    double dist2 = x[0] * x[0] + x[1] * x[1];
+    return dist2 >= g_inner2 && dist2 <= g_outer2;
+}
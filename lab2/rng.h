@@ -0,0 +1,80 @@
+#ifndef LAB2_RNG_H
+#define LAB2_RNG_H
+
+/*
+ * Быстрый ГПСЧ для потоков Монте-Карло: xoshiro256+ (Blackman, Vigna).
+ *
+ * Состояние — 4 слова по 64 бита, у каждого потока своё, поэтому никаких
+ * блокировок и общего состояния, как у rand(). Поток ГПСЧ выбирается по
+ * номеру (номер задачи): начальное состояние получается из (seed, номер)
+ * через splitmix64, так что одна и та же задача всегда даёт одни и те же
+ * точки, какой бы поток её ни взял, — результат воспроизводим при любом
+ * числе потоков.
+ *
+ * xoshiro256+ выбран ради скорости: у него слабые только младшие биты,
+ * а в double идут старшие 52.
+ */
+
+#include <stdint.h>
+
+#define RNG_DEFAULT_SEED 0x243F6A8885A308D3ULL
+
+typedef struct {
+    uint64_t s[4];
+} rng_t;
+
+static inline uint64_t rng_splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * Начальное состояние потока номер stream. Соседние номера дают
+ * некоррелированные состояния: splitmix64 хорошо перемешивает даже
+ * последовательные входы.
+ */
+static inline void rng_seed(rng_t *r, uint64_t seed, uint64_t stream) {
+    uint64_t x = seed ^ rng_splitmix64(&stream);
+    for (int i = 0; i < 4; i++) {
+        r->s[i] = rng_splitmix64(&x);
+    }
+}
+
+static inline uint64_t rng_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next(rng_t *r) {
+    uint64_t *s = r->s;
+    uint64_t result = s[0] + s[3];
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+
+    return result;
+}
+
+/*
+ * 64 случайных бита -> double в [0, 1) без деления: старшие 52 бита
+ * кладём в мантиссу числа с порядком 0 (это [1, 2)) и вычитаем 1.
+ */
+static inline double rng_to_double(uint64_t v) {
+    union {
+        uint64_t u;
+        double d;
+    } bits = {.u = (v >> 12) | 0x3FF0000000000000ULL};
+    return bits.d - 1.0;
+}
+
+static inline double rng_next_double(rng_t *r) {
+    return rng_to_double(rng_next(r));
+}
+
+#endif // LAB2_RNG_H
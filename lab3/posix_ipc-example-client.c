@@ -6,25 +6,22 @@
 #include <sys/stat.h>    // для shm_open()
 #include <sys/types.h>   // для pid_t
 #include <string.h>      // для strlen(), strcpy(), strcat(), memset() и т.д.
-#include <semaphore.h>   // для sem_open(), sem_wait() и т.д.
 #include <errno.h>       // для errno
 
+#include "shm_pool.h"    // полосы пула валидаторов в shm_data
+#include "shm_err.h"     // кольца сообщений об ошибках в shm_err
+#include "../common/batch_writer.h"  // пакетная запись принятых строк
+#include "../common/line_validate.h" // проверка окончаний строк (SIMD)
+
 // ----------------------------------------------
-// Общие параметры для data-шм
+// Общие параметры для data-шм (полосы с кольцами строк, см. shm_pool.h)
 // ----------------------------------------------
 #define SHM_DATA_NAME         "/posix_ipc_example_data"
-#define SEM_CAN_WRITE_DATA    "/posix_ipc_example_can_write_data"
-#define SEM_CAN_READ_DATA     "/posix_ipc_example_can_read_data"
 
 // ----------------------------------------------
 // Общие параметры для err-шм
 // ----------------------------------------------
 #define SHM_ERR_NAME          "/posix_ipc_example_err"
-#define SEM_CAN_WRITE_ERR     "/posix_ipc_example_can_write_err"
-#define SEM_CAN_READ_ERR      "/posix_ipc_example_can_read_err"
-
-// ----------------------------------------------
-#define SHM_SIZE 4096
 
 //------------------------------------------------------------------------------
 // Функция для вывода C-строки (null-terminated) в указанный дескриптор
@@ -43,16 +40,32 @@ static void simple_perror(const char *msg)
     write_str_to_fd(STDERR_FILENO, "\n");
 }
 
+//------------------------------------------------------------------------------
+// Всё, что нужно ребёнку для работы и сообщений родителю
+typedef struct {
+    shm_pool_t *pool;
+    unsigned workers;
+    size_t pool_size;
+    shm_err_t *err;
+    err_ring_t *err_ring;   // своё кольцо ошибок
+
+    // Результат разбора слота ядром line_validate. Строк в слоте не больше,
+    // чем байт: каждая занимает хотя бы '\n'
+    uint32_t *ends;
+    uint64_t *ok_bits;
+    size_t scan_max;
+
+    // Сборка строки, пришедшей несколькими слотами (RING_REC_MORE)
+    char *long_buf;
+    size_t long_len;
+    size_t long_cap;
+} client_ctx_t;
+
 //------------------------------------------------------------------------------
 // Завершение с очисткой ресурсов
 static void cleanup_and_exit(
         int fd_file,
-        char *shm_data,
-        char *shm_err,
-        sem_t *sem_can_write_data,
-        sem_t *sem_can_read_data,
-        sem_t *sem_can_write_err,
-        sem_t *sem_can_read_err,
+        client_ctx_t *ctx,
         int exit_code
 ) {
     // Закрываем файл
@@ -60,29 +73,281 @@ static void cleanup_and_exit(
         close(fd_file);
     }
     // Отключаем shm_data
-    if (shm_data && shm_data != MAP_FAILED) {
-        munmap(shm_data, SHM_SIZE);
+    if (ctx->pool && ctx->pool != MAP_FAILED) {
+        munmap(ctx->pool, ctx->pool_size);
     }
     // Отключаем shm_err
-    if (shm_err && shm_err != MAP_FAILED) {
-        munmap(shm_err, SHM_SIZE);
+    if (ctx->err && ctx->err != MAP_FAILED) {
+        munmap(ctx->err, err_shm_size(err_channels(ctx->workers)));
+    }
+
+    free(ctx->ends);
+    free(ctx->ok_bits);
+    free(ctx->long_buf);
+
+    // Выходим
+    exit(exit_code);
+}
+
+//------------------------------------------------------------------------------
+// Сообщить родителю о строке с неправильным окончанием (line — без '\n').
+// Не ждёт: если кольцо ошибок полно, сообщение отбрасывается (учтётся
+// в счётчике dropped), а проверка строк идёт дальше.
+static void report_bad_line(client_ctx_t *ctx, const char *line, size_t len)
+{
+    static const char prefix[] = "child error: string does not end with '.' or ';'. The string was: ";
+    // Собираем сообщение прямо в кольце (с обрезкой по ERR_TEXT_MAX)
+    size_t used = sizeof(prefix) - 1;
+    size_t room = ERR_TEXT_MAX - used;
+    size_t n = len < room ? len : room;
+    char *text = err_try_begin(ctx->err_ring, (uint32_t)(used + n));
+    if (!text) {
+        return;
+    }
+    memcpy(text, prefix, used);
+    memcpy(text + used, line, n);
+    err_commit(ctx->err_ring, (uint32_t)(used + n), &ctx->pool->parent);
+}
+
+//------------------------------------------------------------------------------
+// Сообщить родителю об ошибке записи в файл
+static void report_write_error(client_ctx_t *ctx)
+{
+    // Если нужно вывести число errno, нужно int->str. Упростим:
+    // Выведем просто "... , errno\n"
+    static const char msg[] = "child error: write to file failed, errno=?\n";
+    char *text = err_try_begin(ctx->err_ring, sizeof(msg) - 1);
+    if (!text) {
+        return;
+    }
+    memcpy(text, msg, sizeof(msg) - 1);
+    err_commit(ctx->err_ring, sizeof(msg) - 1, &ctx->pool->parent);
+}
+
+//------------------------------------------------------------------------------
+// Куда уходят принятые строки: в файл (один валидатор) или в out-слот
+typedef int (*accept_fn)(void *arg, const char *data, size_t len);
+
+static int accept_to_writer(void *arg, const char *data, size_t len)
+{
+    return bw_append((batch_writer_t *)arg, data, len);
+}
+
+// Выход валидатора пула: out-кольцо и текущий слот результата пачки seq.
+// Если результат не влезает в слот (длинная строка), заполненный слот
+// уходит с RING_REC_MORE, и запись продолжается в следующем.
+typedef struct {
+    shm_ring_t *ring;
+    ring_slot_t *slot;
+    uint32_t seq;
+} out_writer_t;
+
+static ring_slot_t *out_acquire(shm_ring_t *ring, uint32_t seq)
+{
+    ring_slot_t *slot;
+    while ((slot = ring_try_acquire_slot(ring)) == NULL) {
+        ring_wait_space(ring, ring_producer_seq(ring));
+    }
+    slot->seq = seq;
+    slot->len = 0;
+    slot->flags = 0;
+    return slot;
+}
+
+static int accept_to_ring(void *arg, const char *data, size_t len)
+{
+    out_writer_t *ow = arg;
+    size_t cap = ring_slot_capacity(ow->ring);
+    while (len > 0) {
+        if (ow->slot->len == cap) {
+            ow->slot->flags = RING_REC_MORE;
+            ring_publish(ow->ring);
+            ow->slot = out_acquire(ow->ring, ow->seq);
+        }
+        size_t n = cap - ow->slot->len < len ? cap - ow->slot->len : len;
+        memcpy(ow->slot->data + ow->slot->len, data, n);
+        ow->slot->len += (uint32_t)n;
+        data += n;
+        len -= n;
     }
-    // Закрываем семафоры
-    if (sem_can_write_data && sem_can_write_data != SEM_FAILED) {
-        sem_close(sem_can_write_data);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// Проверить строки data[0..len). Строки проверяются ядром line_validate
+// за один проход; подряд идущие принятые строки лежат непрерывно
+// и передаются дальше одним куском, об ошибочных сообщаем родителю.
+static void validate_lines(client_ctx_t *ctx, const char *data, size_t len, accept_fn accept, void *arg)
+{
+    size_t consumed;
+    size_t count = lv_scan(data, len, '\n', ctx->ends, ctx->ok_bits, ctx->scan_max, &consumed);
+
+    size_t start = 0;
+    size_t run_start = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t end = ctx->ends[i] + 1;
+        if (!lv_line_ok(ctx->ok_bits, i)) {
+            // Ошибка: отдаём накопленные до неё строки и сообщаем о ней
+            if (start > run_start && accept(arg, data + run_start, start - run_start) < 0) {
+                report_write_error(ctx);
+            }
+            report_bad_line(ctx, data + start, end - start - 1);
+            run_start = end;
+        }
+        start = end;
     }
-    if (sem_can_read_data && sem_can_read_data != SEM_FAILED) {
-        sem_close(sem_can_read_data);
+    if (start > run_start && accept(arg, data + run_start, start - run_start) < 0) {
+        // Ошибка записи
+        report_write_error(ctx);
     }
-    if (sem_can_write_err && sem_can_write_err != SEM_FAILED) {
-        sem_close(sem_can_write_err);
+}
+
+static int long_append(client_ctx_t *ctx, const char *data, size_t len)
+{
+    if (ctx->long_len + len > ctx->long_cap) {
+        size_t cap = ctx->long_cap ? ctx->long_cap : 65536;
+        while (cap < ctx->long_len + len) {
+            cap *= 2;
+        }
+        char *p = realloc(ctx->long_buf, cap);
+        if (!p) {
+            return -1;
+        }
+        ctx->long_buf = p;
+        ctx->long_cap = cap;
     }
-    if (sem_can_read_err && sem_can_read_err != SEM_FAILED) {
-        sem_close(sem_can_read_err);
+    memcpy(ctx->long_buf + ctx->long_len, data, len);
+    ctx->long_len += len;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// Обработать слот. Обычная пачка проверяется прямо в слоте, без копий.
+// Куски длинной строки (RING_REC_MORE) копятся в long_buf; её конец — первая
+// строка следующего слота без флага, после неё в слоте идут обычные строки.
+static void process_slot(client_ctx_t *ctx, const ring_slot_t *slot, accept_fn accept, void *arg)
+{
+    const char *data = slot->data;
+    size_t len = slot->len;
+
+    if (slot->flags & RING_REC_MORE) {
+        if (long_append(ctx, data, len) < 0) {
+            simple_perror("long line buffer allocation failed");
+            cleanup_and_exit(-1, ctx, 1);
+        }
+        return;
     }
 
-    // Выходим
-    exit(exit_code);
+    if (ctx->long_len > 0) {
+        const char *nl = memchr(data, '\n', len);
+        size_t head = nl ? (size_t)(nl - data) + 1 : len;
+        if (long_append(ctx, data, head) < 0) {
+            simple_perror("long line buffer allocation failed");
+            cleanup_and_exit(-1, ctx, 1);
+        }
+        const char *line = ctx->long_buf;
+        size_t n = ctx->long_len;
+        if (n >= 2 && lv_is_term(line[n - 2])) {
+            if (accept(arg, line, n) < 0) {
+                report_write_error(ctx);
+            }
+        } else {
+            report_bad_line(ctx, line, n - 1);
+        }
+        ctx->long_len = 0;
+        data += head;
+        len -= head;
+    }
+
+    validate_lines(ctx, data, len, accept, arg);
+}
+
+//------------------------------------------------------------------------------
+// Дождаться слота кольца, не держа принятые строки в буфере writer дольше
+// WRITER_FLUSH_MS: пока ввода нет, порог по времени сам не сработает
+static ring_slot_t *peek_flushing(client_ctx_t *ctx, shm_ring_t *ring, batch_writer_t *writer)
+{
+    long ms;
+    while ((ms = bw_due_ms(writer)) >= 0 && !ring_wait_data(ring, ms * 1000000L)) {
+        if (bw_flush_if_due(writer) < 0) {
+            report_write_error(ctx);
+        }
+    }
+    return ring_peek(ring);
+}
+
+//------------------------------------------------------------------------------
+// Единственный валидатор: проверяет и сам пишет файл
+static void run_single(client_ctx_t *ctx, batch_writer_t *writer)
+{
+    shm_ring_t *in = pool_in(ctx->pool, 0);
+    while (1) {
+        // Ждём очередную пачку; NULL — родитель закрыл кольцо (конец ввода)
+        ring_slot_t *slot = peek_flushing(ctx, in, writer);
+        if (slot == NULL) {
+            break;
+        }
+        process_slot(ctx, slot, accept_to_writer, writer);
+
+        // Освобождаем слот — родитель может снова в него писать
+        ring_release(in);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Валидатор пула: принятые строки пачки уходят сборщику с тем же seq
+static void run_worker(client_ctx_t *ctx, unsigned lane)
+{
+    shm_ring_t *in = pool_in(ctx->pool, lane);
+    shm_ring_t *out = pool_out(ctx->pool, lane);
+    while (1) {
+        ring_slot_t *slot = ring_peek(in);
+        if (slot == NULL) {
+            break;
+        }
+
+        // Кусок длинной строки только копится — результата пачки ещё нет
+        if (slot->flags & RING_REC_MORE) {
+            process_slot(ctx, slot, NULL, NULL);
+            ring_release(in);
+            continue;
+        }
+
+        // Принятые строки обычной пачки — её подмножество и влезают в один
+        // слот; длинная строка уходит несколькими (см. accept_to_ring)
+        out_writer_t ow = {out, out_acquire(out, slot->seq), slot->seq};
+        process_slot(ctx, slot, accept_to_ring, &ow);
+        ring_publish(out);
+
+        ring_release(in);
+    }
+    ring_close(out);
+}
+
+//------------------------------------------------------------------------------
+// Сборщик пула: забирает результаты по кругу, т.е. по возрастанию seq
+static void run_merger(client_ctx_t *ctx, batch_writer_t *writer)
+{
+    for (uint32_t seq = 0; ; ) {
+        shm_ring_t *out = pool_out(ctx->pool, seq % ctx->workers);
+        ring_slot_t *res = peek_flushing(ctx, out, writer);
+        if (res == NULL) {
+            // Пачки seq не было — ввод закончился, остальные полосы тоже пусты
+            break;
+        }
+        if (res->seq != seq) {
+            simple_perror("merger: batch sequence mismatch");
+            cleanup_and_exit(-1, ctx, 1);
+        }
+        if (res->len > 0 && bw_append(writer, res->data, res->len) < 0) {
+            report_write_error(ctx);
+        }
+        // Результат пачки может занимать несколько слотов подряд
+        if (!(res->flags & RING_REC_MORE)) {
+            seq++;
+        }
+        ring_release(out);
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -91,11 +356,14 @@ static void cleanup_and_exit(
 //   argv[1] = имя файла (куда писать корректные строки)
 //   argv[2] = имя shm для data
 //   argv[3] = имя shm для err
+// Для пула валидаторов дополнительно:
+//   argv[4] = номер полосы валидатора или "merge" для сборщика
+//   argv[5] = число валидаторов
 //------------------------------------------------------------------------------
 int main(int argc, char *argv[])
 {
-    if (argc < 4) {
-        write_str_to_fd(STDERR_FILENO, "Usage: client <filename> <shm_data> <shm_err>\n");
+    if (argc < 4 || argc == 5) {
+        write_str_to_fd(STDERR_FILENO, "Usage: client <filename> <shm_data> <shm_err> [<lane>|merge <workers>]\n");
         return 1;
     }
 
@@ -103,135 +371,114 @@ int main(int argc, char *argv[])
     char *shm_data_nm = argv[2]; // Имя shm (data)
     char *shm_err_nm  = argv[3]; // Имя shm (err)
 
+    client_ctx_t ctx = {0};
+    ctx.workers = 1;
+    int is_merger = 0;
+    unsigned lane = 0;
+    if (argc >= 6) {
+        ctx.workers = (unsigned)atoi(argv[5]);
+        is_merger = strcmp(argv[4], "merge") == 0;
+        lane = is_merger ? 0 : (unsigned)atoi(argv[4]);
+        if (ctx.workers < 1 || ctx.workers > POOL_MAX_WORKERS || lane >= ctx.workers) {
+            simple_perror("bad lane or workers count");
+            return 1;
+        }
+    }
+    // Файл пишет единственный валидатор или сборщик пула
+    int writes_file = ctx.workers == 1 || is_merger;
+
     // 1) Открываем файл на запись (перезапись + добавление)
-    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
-    if (fd == -1) {
-        simple_perror("open output file failed");
-        return 1;
+    int fd = -1;
+    if (writes_file) {
+        fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+        if (fd == -1) {
+            simple_perror("open output file failed");
+            return 1;
+        }
     }
 
     // 2) Подключаемся к разделяемой памяти (DATA)
     int shm_fd_data = shm_open(shm_data_nm, O_RDWR, 0666);
     if (shm_fd_data == -1) {
         simple_perror("shm_open data failed");
-        close(fd);
-        return 1;
+        cleanup_and_exit(fd, &ctx, 1);
     }
-    char *shm_data = mmap(NULL, SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd_data, 0);
-    if (shm_data == MAP_FAILED) {
-        simple_perror("mmap data failed");
-        close(fd);
-        close(shm_fd_data);
-        return 1;
+    // Размер колец выбирает родитель — берём размер сегмента целиком
+    struct stat st;
+    if (fstat(shm_fd_data, &st) == -1) {
+        simple_perror("fstat data failed");
+        cleanup_and_exit(fd, &ctx, 1);
     }
+    ctx.pool_size = (size_t)st.st_size;
+    ctx.pool = mmap(NULL, ctx.pool_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd_data, 0);
     close(shm_fd_data);  // дескриптор можно закрыть после mmap
+    if (ctx.pool == MAP_FAILED) {
+        simple_perror("mmap data failed");
+        cleanup_and_exit(fd, &ctx, 1);
+    }
+    if (ctx.pool->workers != ctx.workers) {
+        simple_perror("workers count does not match shm_data");
+        cleanup_and_exit(fd, &ctx, 1);
+    }
+    ctx.scan_max = ring_slot_capacity(pool_in(ctx.pool, 0));
+    ctx.ends = malloc(ctx.scan_max * sizeof(uint32_t));
+    ctx.ok_bits = malloc((ctx.scan_max + 63) / 64 * sizeof(uint64_t));
+    if (!ctx.ends || !ctx.ok_bits) {
+        simple_perror("scan buffer allocation failed");
+        cleanup_and_exit(fd, &ctx, 1);
+    }
 
     // 3) Подключаемся к разделяемой памяти (ERR)
     int shm_fd_err = shm_open(shm_err_nm, O_RDWR, 0666);
     if (shm_fd_err == -1) {
         simple_perror("shm_open err failed");
-        munmap(shm_data, SHM_SIZE);
-        close(fd);
-        return 1;
+        cleanup_and_exit(fd, &ctx, 1);
     }
-    char *shm_err = mmap(NULL, SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd_err, 0);
-    if (shm_err == MAP_FAILED) {
+    ctx.err = mmap(NULL, err_shm_size(err_channels(ctx.workers)), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd_err, 0);
+    close(shm_fd_err);
+    if (ctx.err == MAP_FAILED) {
         simple_perror("mmap err failed");
-        munmap(shm_data, SHM_SIZE);
-        close(fd);
-        close(shm_fd_err);
-        return 1;
+        cleanup_and_exit(fd, &ctx, 1);
     }
-    close(shm_fd_err);
+    // Кольцо ошибок: у валидатора — по номеру полосы, у сборщика — последнее
+    ctx.err_ring = &ctx.err->rings[is_merger ? ctx.workers : lane];
 
-    // 4) Открываем семафоры (уже созданные родителем)
-    sem_t *sem_can_write_data = sem_open(SEM_CAN_WRITE_DATA, 0);
-    if (sem_can_write_data == SEM_FAILED) {
-        simple_perror("sem_open(SEM_CAN_WRITE_DATA) failed");
-        cleanup_and_exit(fd, shm_data, shm_err, NULL, NULL, NULL, NULL, 1);
-    }
-    sem_t *sem_can_read_data  = sem_open(SEM_CAN_READ_DATA, 0);
-    if (sem_can_read_data == SEM_FAILED) {
-        simple_perror("sem_open(SEM_CAN_READ_DATA) failed");
-        cleanup_and_exit(fd, shm_data, shm_err, sem_can_write_data, NULL, NULL, NULL, 1);
-    }
-    sem_t *sem_can_write_err = sem_open(SEM_CAN_WRITE_ERR, 0);
-    if (sem_can_write_err == SEM_FAILED) {
-        simple_perror("sem_open(SEM_CAN_WRITE_ERR) failed");
-        cleanup_and_exit(fd, shm_data, shm_err, sem_can_write_data, sem_can_read_data, NULL, NULL, 1);
-    }
-    sem_t *sem_can_read_err  = sem_open(SEM_CAN_READ_ERR, 0);
-    if (sem_can_read_err == SEM_FAILED) {
-        simple_perror("sem_open(SEM_CAN_READ_ERR) failed");
-        cleanup_and_exit(fd, shm_data, shm_err, sem_can_write_data, sem_can_read_data, sem_can_write_err, NULL, 1);
+    // 4) Сегменты отображены — родитель может удалить их имена из /dev/shm
+    atomic_fetch_add(&ctx.pool->attached, 1);
+    sync_event_signal(&ctx.pool->parent);
+
+    // Принятые строки копим и пишем пачками (см. batch_writer.h)
+    batch_writer_t writer;
+    if (writes_file && bw_init(&writer, fd) < 0) {
+        simple_perror("output buffer allocation failed");
+        cleanup_and_exit(fd, &ctx, 1);
     }
 
     // Сообщаем, что клиент запустился
-    write_str_to_fd(STDOUT_FILENO, "[Child] started, reading from shm_data...\n");
-
-    while (1) {
-        // Ждём разрешения на чтение строки
-        if (sem_wait(sem_can_read_data) < 0) {
-            // Ошибка или сигнал
-            simple_perror("sem_wait(sem_can_read_data) failed");
-            break;
-        }
-
-        // Проверяем, не пустая ли строка => признак окончания
-        if (shm_data[0] == '\0') {
-            // Родитель сообщил об окончании ввода
-            break;
-        }
+    if (is_merger) {
+        write_str_to_fd(STDOUT_FILENO, "[Child] merger started, collecting validated batches...\n");
+    } else if (ctx.workers > 1) {
+        write_str_to_fd(STDOUT_FILENO, "[Child] validator started, reading from its lane...\n");
+    } else {
+        write_str_to_fd(STDOUT_FILENO, "[Child] started, reading from shm_data...\n");
+    }
 
-        // Копируем строку локально
-        char buf[4096];
-        memset(buf, 0, sizeof(buf));
-        strncpy(buf, shm_data, sizeof(buf)-1);
-
-        // Проверяем, заканчивается ли '.' или ';'
-        size_t len = strlen(buf);
-        if (len > 0) {
-            char last_char = buf[len - 1];
-            if (last_char != '.' && last_char != ';') {
-                // Ошибка. Пишем в shm_err
-                if (sem_wait(sem_can_write_err) == 0) {
-                    // Собираем сообщение в shm_err
-                    shm_err[0] = '\0';
-                    strcat(shm_err, "child error: string does not end with '.' or ';'. The string was: ");
-                    strcat(shm_err, buf);
-                    sem_post(sem_can_read_err);
-                } else {
-                    // sem_wait не сработал
-                    simple_perror("sem_wait(sem_can_write_err) failed");
-                }
-            } else {
-                // Строка корректна, пишем в файл + \n
-                strcat(buf, "\n");
-                ssize_t written = write(fd, buf, strlen(buf));
-                if (written < 0) {
-                    // Ошибка записи
-                    if (sem_wait(sem_can_write_err) == 0) {
-                        shm_err[0] = '\0';
-                        strcat(shm_err, "child error: write to file failed, errno=");
-                        // Если нужно вывести число errno, нужно int->str. Упростим:
-                        // Выведем просто "... , errno\n"
-                        strcat(shm_err, "?\n");
-                        sem_post(sem_can_read_err);
-                    }
-                }
-            }
-        }
+    if (is_merger) {
+        run_merger(&ctx, &writer);
+    } else if (ctx.workers > 1) {
+        run_worker(&ctx, lane);
+    } else {
+        run_single(&ctx, &writer);
+    }
 
-        // Освобождаем буфер data
-        sem_post(sem_can_write_data);
+    // Дописываем остаток буфера в файл
+    if (writes_file && bw_close(&writer) < 0) {
+        report_write_error(&ctx);
     }
 
     // Сообщаем, что завершаемся
     write_str_to_fd(STDOUT_FILENO, "[Child] finishing.\n");
 
-    cleanup_and_exit(fd, shm_data, shm_err,
-                     sem_can_write_data, sem_can_read_data,
-                     sem_can_write_err, sem_can_read_err,
-                     0);
+    cleanup_and_exit(fd, &ctx, 0);
     return 0;
 }
@@ -7,26 +7,26 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <string.h>
-#include <semaphore.h>
 #include <errno.h>
 #include <limits.h>
+#include <time.h>
+
+#include "shm_pool.h"
+#include "shm_err.h"
+#include "../common/batch_writer.h"   // bw_writev_all()
 
 // ----------------------------------------------
-// Общие параметры для data-шм
+// Общие параметры для data-шм (полосы с кольцами строк, см. shm_pool.h)
 // ----------------------------------------------
 #define SHM_DATA_NAME         "/posix_ipc_example_data"
-#define SEM_CAN_WRITE_DATA    "/posix_ipc_example_can_write_data"
-#define SEM_CAN_READ_DATA     "/posix_ipc_example_can_read_data"
 
 // ----------------------------------------------
 // Общие параметры для err-шм
 // ----------------------------------------------
 #define SHM_ERR_NAME          "/posix_ipc_example_err"
-#define SEM_CAN_WRITE_ERR     "/posix_ipc_example_can_write_err"
-#define SEM_CAN_READ_ERR      "/posix_ipc_example_can_read_err"
 
-// ----------------------------------------------
-#define SHM_SIZE 4096
+// Предел сна родителя, пока он ждёт завершения детей (их выход не сигналит)
+#define CHILD_POLL_NS         10000000L
 
 static char CLIENT_PROGRAM_NAME[] = "client";
 
@@ -39,11 +39,64 @@ static void write_str_to_fd(int fd, const char *s)
     }
 }
 
+//------------------------------------------------------------------------------
+// Буфер чтения stdin: читаем крупными порциями, а строки выдаём из буфера,
+// чтобы не платить системным вызовом за каждый байт.
+//------------------------------------------------------------------------------
+static char   stdin_buf[65536];
+static size_t stdin_pos = 0;
+static size_t stdin_end = 0;
+
+//------------------------------------------------------------------------------
+// Считываем из stdin очередную часть строки (без '\n'), не больше room байт.
+// *complete = 1 — строка кончилась ('\n' съеден или EOF), 0 — не влезла,
+// продолжение отдаст следующий вызов. Возвращаем число байт; -1 — EOF или
+// ошибка, не прочитав ни байта.
+//------------------------------------------------------------------------------
+static ssize_t read_line_part(char *buf, size_t room, int *complete)
+{
+    size_t pos = 0;
+    *complete = 1;
+    while (1) {
+        if (stdin_pos == stdin_end) {
+            ssize_t rd = read(STDIN_FILENO, stdin_buf, sizeof(stdin_buf));
+            if (rd < 1) {
+                // EOF или ошибка
+                return pos > 0 ? (ssize_t)pos : -1;
+            }
+            stdin_pos = 0;
+            stdin_end = (size_t)rd;
+        }
+
+        // Ищем конец строки в том, что уже прочитано
+        char *start = stdin_buf + stdin_pos;
+        size_t avail = stdin_end - stdin_pos;
+        char *nl = memchr(start, '\n', avail);
+        size_t chunk = nl ? (size_t)(nl - start) : avail;
+
+        if (chunk > room - pos) {
+            // Не влезает — берём сколько можно, остаток ждёт следующего вызова
+            memcpy(buf + pos, start, room - pos);
+            stdin_pos += room - pos;
+            *complete = 0;
+            return (ssize_t)room;
+        }
+        memcpy(buf + pos, start, chunk);
+        pos += chunk;
+        stdin_pos += chunk;
+        if (nl) {
+            // Если встретили '\n' — строка закончилась
+            stdin_pos++;
+            return (ssize_t)pos;
+        }
+    }
+}
+
 //------------------------------------------------------------------------------
 // Считываем *одну строку* с терминала (STDIN_FILENO) без использования stdio.h.
 // Возвращаем количество реально прочитанных байт (не включая '\0' в конце).
 // Если прочитан '\n', заменяем его на '\0'. Если EOF или ошибка — возвращаем 0.
-// Буфер должен быть размером не меньше (buf_size).
+// Не влезший в buf_size хвост строки пропускается.
 //------------------------------------------------------------------------------
 static ssize_t read_line_from_stdin(char *buf, size_t buf_size)
 {
@@ -51,32 +104,123 @@ static ssize_t read_line_from_stdin(char *buf, size_t buf_size)
         return 0;
     }
 
-    size_t pos = 0;
-    char ch;
-    while (1) {
-        ssize_t rd = read(STDIN_FILENO, &ch, 1);
-        if (rd < 1) {
-            // EOF или ошибка
-            break;
-        }
+    int complete;
+    ssize_t len = read_line_part(buf, buf_size - 1, &complete);
+    if (len < 0) {
+        len = 0;
+    }
+    char skip[256];
+    while (!complete && read_line_part(skip, sizeof(skip), &complete) >= 0) {
+    }
 
-        // Если встретили '\n' — завершаем строку
-        if (ch == '\n') {
-            break;
-        }
+    // Добавим null-terminator
+    buf[len] = '\0';
+    return len;
+}
 
-        if (pos < buf_size - 1) {
-            buf[pos++] = ch;
-        }
-        else {
-            // Достигли конца буфера — больше не пишем
-            // но продолжаем считывать, чтобы очистить stdin до конца строки
-        }
+//------------------------------------------------------------------------------
+// Забираем следующую строку (вместе с '\n'), только если она уже целиком лежит
+// в буфере stdin и помещается в room байт — так в слот докладываются строки
+// без лишнего ожидания ввода. Возвращаем число записанных байт; 0 — строки
+// нет или она не влезает (ничего не тронуто); -1 — пустая строка (конец ввода).
+//------------------------------------------------------------------------------
+static ssize_t take_buffered_line(char *dst, size_t room)
+{
+    char *start = stdin_buf + stdin_pos;
+    char *nl = memchr(start, '\n', stdin_end - stdin_pos);
+    if (!nl) {
+        return 0;
     }
 
-    // Добавим null-terminator
-    buf[pos] = '\0';
-    return (ssize_t)pos;
+    size_t len = (size_t)(nl - start) + 1;
+    if (len == 1) {
+        stdin_pos++;
+        return -1;
+    }
+    if (len > room) {
+        return 0;
+    }
+    memcpy(dst, start, len);
+    stdin_pos += len;
+    return (ssize_t)len;
+}
+
+//------------------------------------------------------------------------------
+// Беззнаковое число -> десятичная строка (без stdio.h)
+//------------------------------------------------------------------------------
+static void uint_to_str(unsigned value, char *buf)
+{
+    char tmp[16];
+    int i = 0;
+    do {
+        tmp[i++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    int len = 0;
+    while (i > 0) {
+        buf[len++] = tmp[--i];
+    }
+    buf[len] = '\0';
+}
+
+//------------------------------------------------------------------------------
+static long env_long(const char *name, long fallback)
+{
+    const char *v = getenv(name);
+    return (v && *v) ? atol(v) : fallback;
+}
+
+//------------------------------------------------------------------------------
+// Число валидаторов: VALIDATOR_WORKERS из окружения или число ядер,
+// в пределах 1..POOL_MAX_WORKERS
+//------------------------------------------------------------------------------
+static unsigned choose_workers(void)
+{
+    long n = env_long("VALIDATOR_WORKERS", sysconf(_SC_NPROCESSORS_ONLN));
+    if (n < 1) {
+        n = 1;
+    }
+    if (n > POOL_MAX_WORKERS) {
+        n = POOL_MAX_WORKERS;
+    }
+    return (unsigned)n;
+}
+
+//------------------------------------------------------------------------------
+// Запуск дочернего client. role/workers == NULL — единственный валидатор,
+// иначе номер полосы (или "merge") и число валидаторов пула.
+//------------------------------------------------------------------------------
+static pid_t spawn_client(const char *progpath, char *file, char *role, char *workers)
+{
+    pid_t child = fork();
+    if (child != 0) {
+        return child;
+    }
+
+    // child
+    char path[1024];
+    // Собираем что-то вроде /home/user/.../client
+    // без snprintf (он из stdio.h), используем strncat и т.д.
+    memset(path, 0, sizeof(path));
+    strncpy(path, progpath, sizeof(path) - 1);
+    strncat(path, "/", sizeof(path) - strlen(path) - 1);
+    strncat(path, CLIENT_PROGRAM_NAME, sizeof(path) - strlen(path) - 1);
+
+    // Формируем аргументы для execv
+    char *const args[] = {
+            CLIENT_PROGRAM_NAME,
+            file,
+            SHM_DATA_NAME,
+            SHM_ERR_NAME,
+            role,
+            workers,
+            NULL
+    };
+    execv(path, args);
+
+    // если execv вернулся — ошибка
+    write_str_to_fd(STDERR_FILENO, "execv failed\n");
+    _exit(EXIT_FAILURE);
 }
 
 //------------------------------------------------------------------------------
@@ -93,6 +237,96 @@ static void simple_perror(const char *msg)
     write_str_to_fd(STDERR_FILENO, "\n");
 }
 
+//------------------------------------------------------------------------------
+// Не удалось запустить очередного ребёнка: закрываем входные кольца уже
+// запущенных валидаторов (они дочитают пустую полосу и выйдут), удаляем
+// имена сегментов и дожидаемся started детей, чтобы не оставить ни зомби,
+// ни файлов в /dev/shm.
+//------------------------------------------------------------------------------
+static void abort_spawn(shm_pool_t *pool, unsigned started)
+{
+    simple_perror("fork");
+    for (unsigned i = 0; i < started && i < pool->workers; i++) {
+        ring_close(pool_in(pool, i));
+    }
+    shm_unlink(SHM_DATA_NAME);
+    shm_unlink(SHM_ERR_NAME);
+    while (started > 0) {
+        if (waitpid(-1, NULL, 0) > 0) {
+            started--;
+        } else if (errno != EINTR) {
+            break;
+        }
+    }
+    exit(EXIT_FAILURE);
+}
+
+//------------------------------------------------------------------------------
+// Неблокирующая проверка канала ошибок: за один проход забираем все
+// накопленные сообщения из колец всех детей и выводим их пачкой через
+// writev(). Пока ошибок нет — это лишь чтение пары слов на кольцо.
+//------------------------------------------------------------------------------
+#define ERR_IOV_MAX 1023   // кратно трём iovec на сообщение, не больше IOV_MAX
+
+static void report_child_error(shm_err_t *err)
+{
+    static const char prefix[] = "[Parent] Child error message: ";
+    struct iovec iov[ERR_IOV_MAX];
+    int iovcnt = 0;
+
+    for (unsigned c = 0; c < err->channels; c++) {
+        err_ring_t *r = &err->rings[c];
+        uint32_t pos = err_tail(r);
+        uint32_t head = err_head(r);
+        const char *text;
+        uint32_t len;
+        while ((text = err_next(r, &pos, head, &len)) != NULL) {
+            iov[iovcnt].iov_base = (char *)prefix;
+            iov[iovcnt++].iov_len = sizeof(prefix) - 1;
+            iov[iovcnt].iov_base = (char *)text;
+            iov[iovcnt++].iov_len = len;
+            iov[iovcnt].iov_base = "\n";
+            iov[iovcnt++].iov_len = 1;
+            if (iovcnt == ERR_IOV_MAX) {
+                bw_writev_all(STDOUT_FILENO, iov, iovcnt);
+                iovcnt = 0;
+                err_release(r, pos);
+            }
+        }
+        // Записи кольца указаны в iov — освобождаем их только после вывода
+        if (iovcnt > 0) {
+            bw_writev_all(STDOUT_FILENO, iov, iovcnt);
+            iovcnt = 0;
+        }
+        err_release(r, head);
+
+        uint32_t dropped = err_take_dropped(r);
+        if (dropped > 0) {
+            char num[16];
+            uint_to_str(dropped, num);
+            write_str_to_fd(STDOUT_FILENO, "[Parent] Child error messages dropped (error ring full): ");
+            write_str_to_fd(STDOUT_FILENO, num);
+            write_str_to_fd(STDOUT_FILENO, "\n");
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Свободный слот in-кольца. Пока кольцо полно, обслуживаем канал ошибок:
+// ребёнок может ждать, пока мы их заберём, поэтому ждём "место ИЛИ ошибка"
+// одним ожиданием — оба события сигналят в pool->parent.
+//------------------------------------------------------------------------------
+static ring_slot_t *acquire_slot(shm_ring_t *ring, shm_err_t *err)
+{
+    ring_slot_t *slot;
+    while ((slot = ring_try_acquire_slot(ring)) == NULL) {
+        uint32_t wake = ring_producer_seq(ring);
+        report_child_error(err);
+        ring_wait_space(ring, wake);
+    }
+    return slot;
+}
+
 //------------------------------------------------------------------------------
 
 int main(void)
@@ -106,93 +340,61 @@ int main(void)
         exit(EXIT_FAILURE);
     }
 
-    // 2) Создаем/открываем shm (DATA)
+    // 2) Создаем/открываем shm (DATA) — в нём по полосе на валидатора
+    //    Размер колец: RING_SLOTS слотов по RING_SLOT_SIZE байт (из окружения)
+    unsigned workers = choose_workers();
+    uint32_t slot_count, slot_size;
+    ring_geometry(env_long("RING_SLOTS", RING_DEFAULT_SLOTS), env_long("RING_SLOT_SIZE", RING_DEFAULT_SLOT),
+                  &slot_count, &slot_size);
+    size_t data_size = pool_shm_size(workers, slot_count, slot_size);
     int shm_fd_data = shm_open(SHM_DATA_NAME, O_CREAT | O_RDWR, 0666);
     if (shm_fd_data == -1) {
         simple_perror("shm_open data");
         exit(EXIT_FAILURE);
     }
-    if (ftruncate(shm_fd_data, SHM_SIZE) == -1) {
+    if (ftruncate(shm_fd_data, data_size) == -1) {
         simple_perror("ftruncate data");
         shm_unlink(SHM_DATA_NAME);
         exit(EXIT_FAILURE);
     }
-    char *shm_data = mmap(NULL, SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd_data, 0);
-    if (shm_data == MAP_FAILED) {
+    shm_pool_t *pool = mmap(NULL, data_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd_data, 0);
+    if (pool == MAP_FAILED) {
         simple_perror("mmap data");
         shm_unlink(SHM_DATA_NAME);
         exit(EXIT_FAILURE);
     }
-    memset(shm_data, 0, SHM_SIZE);
+    close(shm_fd_data);
+    pool_init(pool, workers, slot_count, slot_size);
 
     // 3) Создаем/открываем shm (ERRORS)
     int shm_fd_err = shm_open(SHM_ERR_NAME, O_CREAT | O_RDWR, 0666);
     if (shm_fd_err == -1) {
         simple_perror("shm_open err");
-        munmap(shm_data, SHM_SIZE);
+        munmap(pool, data_size);
         shm_unlink(SHM_DATA_NAME);
         exit(EXIT_FAILURE);
     }
-    if (ftruncate(shm_fd_err, SHM_SIZE) == -1) {
+    size_t err_size = err_shm_size(err_channels(workers));
+    if (ftruncate(shm_fd_err, err_size) == -1) {
         simple_perror("ftruncate err");
         shm_unlink(SHM_ERR_NAME);
-        munmap(shm_data, SHM_SIZE);
+        munmap(pool, data_size);
         shm_unlink(SHM_DATA_NAME);
         exit(EXIT_FAILURE);
     }
-    char *shm_err = mmap(NULL, SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd_err, 0);
-    if (shm_err == MAP_FAILED) {
+    shm_err_t *err = mmap(NULL, err_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd_err, 0);
+    if (err == MAP_FAILED) {
         simple_perror("mmap err");
-        munmap(shm_data, SHM_SIZE);
-        shm_unlink(SHM_DATA_NAME);
-        shm_unlink(SHM_ERR_NAME);
-        exit(EXIT_FAILURE);
-    }
-    memset(shm_err, 0, SHM_SIZE);
-
-    // 4) Создаем семафоры для data
-    sem_unlink(SEM_CAN_WRITE_DATA);
-    sem_t* sem_can_write_data = sem_open(SEM_CAN_WRITE_DATA, O_CREAT, 0666, 1);
-    if (sem_can_write_data == SEM_FAILED) {
-        simple_perror("sem_open write_data");
-        munmap(shm_data, SHM_SIZE);
-        munmap(shm_err, SHM_SIZE);
+        munmap(pool, data_size);
         shm_unlink(SHM_DATA_NAME);
         shm_unlink(SHM_ERR_NAME);
         exit(EXIT_FAILURE);
     }
+    close(shm_fd_err);
+    err_init(err, err_channels(workers));
 
-    sem_unlink(SEM_CAN_READ_DATA);
-    sem_t* sem_can_read_data = sem_open(SEM_CAN_READ_DATA, O_CREAT, 0666, 0);
-    if (sem_can_read_data == SEM_FAILED) {
-        simple_perror("sem_open read_data");
-        sem_close(sem_can_write_data);
-        sem_unlink(SEM_CAN_WRITE_DATA);
-        munmap(shm_data, SHM_SIZE);
-        munmap(shm_err, SHM_SIZE);
-        shm_unlink(SHM_DATA_NAME);
-        shm_unlink(SHM_ERR_NAME);
-        exit(EXIT_FAILURE);
-    }
-
-    // 5) Создаем семафоры для err
-    sem_unlink(SEM_CAN_WRITE_ERR);
-    sem_t* sem_can_write_err = sem_open(SEM_CAN_WRITE_ERR, O_CREAT, 0666, 1);
-    if (sem_can_write_err == SEM_FAILED) {
-        simple_perror("sem_open write_err");
-        // по аналогии освобождаем всё
-        // ...
-        exit(EXIT_FAILURE);
-    }
-
-    sem_unlink(SEM_CAN_READ_ERR);
-    sem_t* sem_can_read_err = sem_open(SEM_CAN_READ_ERR, O_CREAT, 0666, 0);
-    if (sem_can_read_err == SEM_FAILED) {
-        simple_perror("sem_open read_err");
-        // по аналогии освобождаем всё
-        // ...
-        exit(EXIT_FAILURE);
-    }
+    // 4-5) Вся синхронизация — атомики и futex внутри сегментов
+    //      (shm_sync.h), именованные семафоры не нужны
 
     // 6) Получаем путь к каталогу текущего исполняемого файла (readlink)
     //    Ищем последний '/', чтобы обрезать до директории
@@ -207,39 +409,48 @@ int main(void)
         --len;
     progpath[len] = '\0';
 
-    // 7) Запускаем дочерний процесс (fork)
-    pid_t child = fork();
-    if (child < 0) {
-        simple_perror("fork");
-        // чистим
-        exit(EXIT_FAILURE);
+    // 7) Запускаем дочерние процессы (fork): один валидатор, который сам
+    //    пишет файл, или пул валидаторов и сборщик их результатов
+    unsigned child_count = 0;
+    if (workers == 1) {
+        if (spawn_client(progpath, file, NULL, NULL) < 0) {
+            abort_spawn(pool, 0);
+        }
+        child_count = 1;
+    } else {
+        char workers_str[16];
+        uint_to_str(workers, workers_str);
+        for (unsigned i = 0; i <= workers; i++) {
+            char lane_str[16];
+            uint_to_str(i, lane_str);
+            char *role = i < workers ? lane_str : "merge";
+            if (spawn_client(progpath, file, role, workers_str) < 0) {
+                abort_spawn(pool, child_count);
+            }
+            child_count++;
+        }
     }
-    else if (child == 0) {
-        // child
-        char path[1024];
-        // Собираем что-то вроде /home/user/.../client
-        // без snprintf (он из stdio.h), используем strncat и т.д.
-        // Но можно сделать так:
-        memset(path, 0, sizeof(path));
-        strncpy(path, progpath, sizeof(path) - 1);
-        strncat(path, "/", sizeof(path) - strlen(path) - 1);
-        strncat(path, CLIENT_PROGRAM_NAME, sizeof(path) - strlen(path) - 1);
-
-        // Формируем аргументы для execv
-        char *const args[] = {
-                CLIENT_PROGRAM_NAME,
-                file,
-                SHM_DATA_NAME,
-                SHM_ERR_NAME,
-                NULL
-        };
-        execv(path, args);
-
-        // если execv вернулся — ошибка
-        write_str_to_fd(STDERR_FILENO, "execv failed\n");
-        _exit(EXIT_FAILURE);
+
+    // 8) Дети подключаются к сегментам по имени; когда все подключились
+    //    (или умерли, не успев), имена больше не нужны — удаляем их сразу,
+    //    чтобы после аварии в /dev/shm ничего не осталось
+    int status = 0;
+    unsigned exited = 0;
+    while (atomic_load(&pool->attached) + exited < child_count) {
+        uint32_t wake = sync_event_seq(&pool->parent);
+        if (waitpid(-1, &status, WNOHANG) > 0) {
+            exited++;
+            continue;
+        }
+        if (atomic_load(&pool->attached) + exited < child_count) {
+            sync_event_wait(&pool->parent, wake, CHILD_POLL_NS);
+        }
     }
-    else {
+    child_count -= exited;
+    shm_unlink(SHM_DATA_NAME);
+    shm_unlink(SHM_ERR_NAME);
+
+    {
         // parent
         pid_t pid = getpid();
 
@@ -251,65 +462,91 @@ int main(void)
         // Или вывести "Parent started\n"
         write_str_to_fd(STDOUT_FILENO, "Parent started. Start typing lines. Press Enter on empty line or Ctrl-D to exit\n");
 
-        // Основной цикл ввода от пользователя
-        char input_buf[4096];
-        while (1) {
+        // Приглашение имеет смысл только для терминала: при вводе из файла
+        // или канала оно стоило бы лишнего write() на каждую строку
+        int interactive = isatty(STDIN_FILENO);
+
+        // Основной цикл ввода от пользователя.
+        // Пачка seq уходит в полосу seq % workers — по кругу
+        uint32_t seq = 0;
+        int done = 0;
+        while (!done) {
             // 1) Неблокирующе проверим, нет ли ошибок от ребёнка
-            if (sem_trywait(sem_can_read_err) == 0) {
-                // читаем ошибку из shm_err
-                // затем освобождаем буфер для следующей ошибки
-                write_str_to_fd(STDOUT_FILENO, "[Parent] Child error message: ");
-                write_str_to_fd(STDOUT_FILENO, shm_err);
-                write_str_to_fd(STDOUT_FILENO, "\n");
-                sem_post(sem_can_write_err);
-            }
-            // если -1 c EAGAIN — нет ошибок, идём дальше
+            report_child_error(err);
 
-            // 2) Читаем строку
-            write_str_to_fd(STDOUT_FILENO, "> "); // чтобы было видно приглашение
-            ssize_t rdlen = read_line_from_stdin(input_buf, sizeof(input_buf));
+            // 2) Берём свободный слот кольца и читаем строки прямо в него.
+            //    В слоте лежат строки вместе с '\n' — ровно то, что пойдёт в файл.
+            if (interactive) {
+                write_str_to_fd(STDOUT_FILENO, "> "); // чтобы было видно приглашение
+            }
+            shm_ring_t *ring = pool_in(pool, seq % workers);
+            size_t cap = ring_slot_capacity(ring) - 1;   // место под '\n'
+            ring_slot_t *slot = acquire_slot(ring, err);
+            int complete;
+            ssize_t rdlen = read_line_part(slot->data, cap, &complete);
             if (rdlen <= 0) {
-                // EOF или ошибка
+                // EOF, ошибка или пустая строка — завершаем
                 break;
             }
-            // Если пользователь ввёл пустую строку — завершаем
-            if (input_buf[0] == '\0') {
-                break;
+            while (!complete) {
+                // Строка длиннее слота: отдаём кусок с RING_REC_MORE и читаем
+                // продолжение в следующий слот той же полосы под тем же seq
+                slot->seq = seq;
+                slot->len = (uint32_t)rdlen;
+                slot->flags = RING_REC_MORE;
+                ring_publish(ring);
+
+                slot = acquire_slot(ring, err);
+                rdlen = read_line_part(slot->data, cap, &complete);
+                if (rdlen < 0) {
+                    // EOF посреди строки — строка кончилась
+                    rdlen = 0;
+                    complete = 1;
+                }
+            }
+            slot->data[rdlen] = '\n';
+            size_t used = (size_t)rdlen + 1;
+
+            // Докладываем строки, которые уже прочитаны и целиком влезают:
+            // при вводе из файла/канала слот уходит пачкой, с терминала — по строке
+            ssize_t more;
+            while ((more = take_buffered_line(slot->data + used, cap + 1 - used)) > 0) {
+                used += (size_t)more;
+            }
+            if (more < 0) {
+                done = 1;
             }
 
-            // 3) Пишем в shm_data
-            sem_wait(sem_can_write_data); // ожидаем, что буфер свободен
-            strncpy(shm_data, input_buf, SHM_SIZE - 1);
-            shm_data[SHM_SIZE - 1] = '\0';
-            sem_post(sem_can_read_data);
+            // 3) Публикуем пачку; ждать ребёнка не нужно, пока есть слоты
+            slot->seq = seq++;
+            slot->len = (uint32_t)used;
+            slot->flags = 0;
+            ring_publish(ring);
         }
 
-        // Сигнализируем ребёнку, что данных больше не будет (пустая строка)
-        sem_wait(sem_can_write_data);
-        shm_data[0] = '\0';
-        sem_post(sem_can_read_data);
-
-        // Ждём, пока ребёнок завершится
-        int status = 0;
-        waitpid(child, &status, 0);
-
-        // Закрываем семафоры
-        sem_close(sem_can_write_data);
-        sem_close(sem_can_read_data);
-        sem_unlink(SEM_CAN_WRITE_DATA);
-        sem_unlink(SEM_CAN_READ_DATA);
-
-        sem_close(sem_can_write_err);
-        sem_close(sem_can_read_err);
-        sem_unlink(SEM_CAN_WRITE_ERR);
-        sem_unlink(SEM_CAN_READ_ERR);
+        // Сигнализируем валидаторам, что данных больше не будет
+        for (unsigned i = 0; i < workers; i++) {
+            ring_close(pool_in(pool, i));
+        }
 
-        // Отключаем shm
-        munmap(shm_data, SHM_SIZE);
-        shm_unlink(SHM_DATA_NAME);
+        // Ждём, пока дети завершатся, дочитывая их последние ошибки
+        while (child_count > 0) {
+            uint32_t wake = sync_event_seq(&pool->parent);
+            while (child_count > 0 && waitpid(-1, &status, WNOHANG) > 0) {
+                child_count--;
+            }
+            if (child_count == 0) {
+                break;
+            }
+            // Спим на событии родителя, а не вслепую: ошибка будит сразу
+            report_child_error(err);
+            sync_event_wait(&pool->parent, wake, CHILD_POLL_NS);
+        }
+        report_child_error(err);
 
-        munmap(shm_err, SHM_SIZE);
-        shm_unlink(SHM_ERR_NAME);
+        // Отключаем shm (имена удалены сразу после запуска детей)
+        munmap(pool, data_size);
+        munmap(err, err_size);
 
         write_str_to_fd(STDOUT_FILENO, "Parent finished.\n");
     }
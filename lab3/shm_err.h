@@ -0,0 +1,147 @@
+#ifndef POSIX_IPC_SHM_ERR_H
+#define POSIX_IPC_SHM_ERR_H
+
+// ----------------------------------------------
+// Канал ошибок в err-шм: по кольцу сообщений на каждого ребёнка.
+//
+// Кольцо — SPSC (пишет один ребёнок, читает родитель), поэтому запись
+// сообщения не требует блокировок. Если родитель не успевает и кольцо
+// полно, сообщение не ждёт места, а отбрасывается со счётчиком dropped:
+// поток данных никогда не стоит из-за ошибок. Родитель за один проход
+// забирает всё накопленное из всех колец и сообщает, сколько потеряно.
+// О новом сообщении родитель узнаёт по своему событию (pool->parent).
+// ----------------------------------------------
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "shm_sync.h"
+
+#define ERR_RING_BYTES     (1024 * 1024)       // обязательно степень двойки
+#define ERR_TEXT_MAX       4096                // длиннее сообщения обрезаются
+#define ERR_ALIGN          8
+#define ERR_WRAP           UINT32_MAX          // запись-заглушка до конца буфера
+#define ERR_CACHE_LINE     64
+
+// Записи переменной длины: uint32_t len, текст, выравнивание до ERR_ALIGN.
+// Запись не разрезается по концу буфера: если не влезает, остаток буфера
+// закрывается заглушкой ERR_WRAP и запись начинается с нуля.
+typedef struct {
+    _Alignas(ERR_CACHE_LINE) _Atomic uint32_t head;     // байтовое смещение, пишет ребёнок
+    _Atomic uint32_t dropped;                           // сообщений отброшено (растёт)
+    _Alignas(ERR_CACHE_LINE) _Atomic uint32_t tail;     // пишет родитель
+    uint32_t dropped_seen;                              // сколько потерь родитель уже вывел
+    _Alignas(ERR_CACHE_LINE) char buf[ERR_RING_BYTES];
+} err_ring_t;
+
+typedef struct {
+    uint32_t channels;
+    err_ring_t rings[];
+} shm_err_t;
+
+// Кольцо у каждого валидатора и у сборщика; единственному валидатору — одно
+static inline unsigned err_channels(unsigned workers)
+{
+    return workers > 1 ? workers + 1 : 1;
+}
+
+static inline size_t err_shm_size(unsigned channels)
+{
+    return sizeof(shm_err_t) + sizeof(err_ring_t) * channels;
+}
+
+// Вызывает родитель до fork()
+static inline void err_init(shm_err_t *err, unsigned channels)
+{
+    err->channels = channels;
+    for (unsigned i = 0; i < channels; i++) {
+        err_ring_t *r = &err->rings[i];
+        atomic_store(&r->head, 0);
+        atomic_store(&r->tail, 0);
+        atomic_store(&r->dropped, 0);
+        r->dropped_seen = 0;
+    }
+}
+
+static inline uint32_t err_record_size(uint32_t len)
+{
+    return (uint32_t)((sizeof(uint32_t) + len + ERR_ALIGN - 1) & ~(uint32_t)(ERR_ALIGN - 1));
+}
+
+//------------------------------------------------------------------------------
+// Ребёнок: место под текст длиной len (не больше ERR_TEXT_MAX) или NULL —
+// кольцо полно, потеря уже учтена. Заполнив текст, вызвать err_commit().
+static inline char *err_try_begin(err_ring_t *r, uint32_t len)
+{
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    uint32_t pos = head & (ERR_RING_BYTES - 1);
+    uint32_t need = err_record_size(len);
+    uint32_t pad = pos + need > ERR_RING_BYTES ? ERR_RING_BYTES - pos : 0;
+
+    if (ERR_RING_BYTES - (head - tail) < pad + need) {
+        atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+    if (pad > 0) {
+        *(uint32_t *)(r->buf + pos) = ERR_WRAP;
+        atomic_store_explicit(&r->head, head + pad, memory_order_release);
+        pos = 0;
+    }
+    *(uint32_t *)(r->buf + pos) = len;
+    return r->buf + pos + sizeof(uint32_t);
+}
+
+static inline void err_commit(err_ring_t *r, uint32_t len, sync_event_t *parent)
+{
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    atomic_store_explicit(&r->head, head + err_record_size(len), memory_order_release);
+    sync_event_signal(parent);
+}
+
+//------------------------------------------------------------------------------
+// Родитель: записи читаются от err_tail() до err_head(), err_next() отдаёт
+// текст очередной записи и его длину (заглушки пропускает) или NULL.
+static inline uint32_t err_tail(err_ring_t *r)
+{
+    return atomic_load_explicit(&r->tail, memory_order_relaxed);
+}
+
+static inline uint32_t err_head(err_ring_t *r)
+{
+    return atomic_load_explicit(&r->head, memory_order_acquire);
+}
+
+static inline const char *err_next(err_ring_t *r, uint32_t *pos, uint32_t head, uint32_t *len)
+{
+    while (*pos != head) {
+        uint32_t off = *pos & (ERR_RING_BYTES - 1);
+        uint32_t n = *(const uint32_t *)(r->buf + off);
+        if (n == ERR_WRAP) {
+            *pos += ERR_RING_BYTES - off;
+            continue;
+        }
+        *pos += err_record_size(n);
+        *len = n;
+        return r->buf + off + sizeof(uint32_t);
+    }
+    return NULL;
+}
+
+// Родитель: записи до new_tail прочитаны, их место свободно
+static inline void err_release(err_ring_t *r, uint32_t new_tail)
+{
+    atomic_store_explicit(&r->tail, new_tail, memory_order_release);
+}
+
+// Родитель: сколько сообщений отброшено с прошлого вызова
+static inline uint32_t err_take_dropped(err_ring_t *r)
+{
+    uint32_t dropped = atomic_load_explicit(&r->dropped, memory_order_relaxed);
+    uint32_t fresh = dropped - r->dropped_seen;
+    r->dropped_seen = dropped;
+    return fresh;
+}
+
+#endif // POSIX_IPC_SHM_ERR_H
@@ -0,0 +1,59 @@
+#ifndef POSIX_IPC_SHM_POOL_H
+#define POSIX_IPC_SHM_POOL_H
+
+// ----------------------------------------------
+// Раскладка data-шм для пула валидаторов.
+//
+// Сегмент — заголовок и полосы (lane), по одной на валидатора; полоса —
+// пара колец in/out. Размер колец задаётся при запуске, поэтому полосы
+// адресуются по смещению (pool_in()/pool_out()), а не массивом структур.
+// Родитель раздаёт пачки строк по полосам по кругу: пачка с номером seq
+// уходит в lanes[seq % workers].in. Валидатор кладёт принятые строки пачки
+// в свой lanes[i].out с тем же seq, а сборщик читает out-кольца в том же
+// круговом порядке — так файл получает строки в исходном порядке ввода.
+// При одном валидаторе он сам пишет файл, и out-кольцо не используется.
+//
+// Родитель ждёт только на pool->parent: в него сигналят освобождение слота
+// любого in-кольца, новая ошибка и подключение ребёнка.
+// ----------------------------------------------
+
+#include "shm_ring.h"
+
+#define POOL_MAX_WORKERS 16
+
+typedef struct {
+    _Alignas(RING_CACHE_LINE) sync_event_t parent;  // событие родителя
+    _Atomic uint32_t attached;                      // сколько детей подключилось к сегментам
+    uint32_t workers;
+    uint64_t ring_size;                             // байт на одно кольцо
+} shm_pool_t;
+
+static inline size_t pool_shm_size(unsigned workers, uint32_t slot_count, uint32_t slot_size)
+{
+    return sizeof(shm_pool_t) + 2 * ring_bytes(slot_count, slot_size) * workers;
+}
+
+static inline shm_ring_t *pool_in(shm_pool_t *pool, unsigned lane)    // родитель -> валидатор
+{
+    return (shm_ring_t *)((char *)(pool + 1) + (2 * (size_t)lane) * pool->ring_size);
+}
+
+static inline shm_ring_t *pool_out(shm_pool_t *pool, unsigned lane)   // валидатор -> сборщик
+{
+    return (shm_ring_t *)((char *)(pool + 1) + (2 * (size_t)lane + 1) * pool->ring_size);
+}
+
+// Вызывает родитель до fork(): in-кольца будят писателя через pool->parent
+static inline void pool_init(shm_pool_t *pool, unsigned workers, uint32_t slot_count, uint32_t slot_size)
+{
+    sync_event_init(&pool->parent);
+    atomic_store(&pool->attached, 0);
+    pool->workers = workers;
+    pool->ring_size = ring_bytes(slot_count, slot_size);
+    for (unsigned i = 0; i < workers; i++) {
+        ring_init(pool_in(pool, i), slot_count, slot_size, &pool->parent);
+        ring_init(pool_out(pool, i), slot_count, slot_size, NULL);
+    }
+}
+
+#endif // POSIX_IPC_SHM_POOL_H
@@ -0,0 +1,249 @@
+#ifndef POSIX_IPC_SHM_RING_H
+#define POSIX_IPC_SHM_RING_H
+
+// ----------------------------------------------
+// Кольцевой буфер "один писатель / один читатель" (SPSC) в разделяемой памяти.
+//
+// Родитель (производитель) кладёт строки в слоты, ребёнок (потребитель)
+// забирает их в том же порядке. Индексы head/tail — монотонно растущие
+// 32-битные счётчики, номер слота = индекс & (slot_count - 1).
+//
+// Геометрия (число слотов и размер слота) задаётся при ring_init() и
+// хранится в самом кольце: слоты лежат сразу за заголовком shm_ring_t.
+// Запись (пачка строк) занимает один слот; строка длиннее слота идёт
+// несколькими слотами подряд — все, кроме последнего, с флагом
+// RING_REC_MORE, и потребитель собирает её обратно.
+// Пока в кольце есть данные/место, обе стороны работают только с атомиками,
+// без системных вызовов. Когда кольцо пусто (читатель) или заполнено
+// (писатель), ждём на событиях shm_sync.h: короткий спин, затем futex.
+//
+// Событие писателя можно вынести за пределы кольца (ring_init(r, space)):
+// тогда несколько колец и другие источники (канал ошибок) будят писателя
+// через одно слово, и он ждёт "место в кольце ИЛИ что-то ещё" одним вызовом.
+// В сегменте хранится не указатель, а смещение — адреса отображения у
+// процессов разные.
+// ----------------------------------------------
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "shm_sync.h"
+
+#define RING_CACHE_LINE     64
+#define RING_DEFAULT_SLOTS  64                // обязательно степень двойки
+#define RING_DEFAULT_SLOT   (16 * 1024)       // размер слота вместе с заголовком
+#define RING_MAX_SLOTS      1024
+#define RING_MIN_SLOT       4096
+#define RING_MAX_SLOT       (1024 * 1024)
+
+#define RING_REC_MORE       1u                // запись продолжается в следующем слоте
+
+typedef struct {
+    uint32_t seq;                 // порядковый номер пачки во входном потоке
+    uint32_t len;                 // число байт в data
+    uint32_t flags;               // RING_REC_*
+    uint32_t reserved;
+    char data[];                  // одна или несколько строк, каждая с '\n'
+} ring_slot_t;
+
+typedef struct {
+    // Линия производителя: head пишет только родитель
+    _Alignas(RING_CACHE_LINE) _Atomic uint32_t head;
+    uint32_t cached_tail;         // последний увиденный tail (локальная копия писателя)
+
+    // Линия потребителя: tail пишет только ребёнок
+    _Alignas(RING_CACHE_LINE) _Atomic uint32_t tail;
+    uint32_t cached_head;         // последний увиденный head (локальная копия читателя)
+
+    // Ожидание: читатель спит на data, писатель — на событии по space_off
+    _Alignas(RING_CACHE_LINE) sync_event_t data;    // растёт при publish и close
+    _Atomic uint32_t closed;
+    int64_t space_off;            // смещение события писателя от начала кольца
+    _Alignas(RING_CACHE_LINE) sync_event_t space;   // событие писателя по умолчанию
+
+    // Геометрия: не меняется после ring_init()
+    _Alignas(RING_CACHE_LINE) uint32_t slot_count;
+    uint32_t slot_size;           // шаг слотов, вместе с заголовком ring_slot_t
+} shm_ring_t;
+
+//------------------------------------------------------------------------------
+// Размер кольца в сегменте. slot_count — степень двойки, slot_size кратен
+// RING_CACHE_LINE (см. ring_geometry()).
+static inline size_t ring_bytes(uint32_t slot_count, uint32_t slot_size)
+{
+    return sizeof(shm_ring_t) + (size_t)slot_count * slot_size;
+}
+
+// Привести заказанные размеры к допустимым: число слотов — степень двойки,
+// слот — кратен линии кэша, всё в пределах RING_MIN/MAX_*
+static inline void ring_geometry(long slots, long slot_size, uint32_t *out_slots, uint32_t *out_size)
+{
+    uint32_t n = 2;
+    while (n < RING_MAX_SLOTS && n < (uint32_t)(slots > 0 ? slots : RING_DEFAULT_SLOTS)) {
+        n *= 2;
+    }
+    if (slot_size <= 0) {
+        slot_size = RING_DEFAULT_SLOT;
+    }
+    if (slot_size < RING_MIN_SLOT) {
+        slot_size = RING_MIN_SLOT;
+    }
+    if (slot_size > RING_MAX_SLOT) {
+        slot_size = RING_MAX_SLOT;
+    }
+    *out_slots = n;
+    *out_size = (uint32_t)((slot_size + RING_CACHE_LINE - 1) & ~(long)(RING_CACHE_LINE - 1));
+}
+
+// Сколько байт строк влезает в слот
+static inline size_t ring_slot_capacity(const shm_ring_t *r)
+{
+    return r->slot_size - sizeof(ring_slot_t);
+}
+
+static inline ring_slot_t *ring_slot(shm_ring_t *r, uint32_t index)
+{
+    return (ring_slot_t *)((char *)(r + 1) + (size_t)(index & (r->slot_count - 1)) * r->slot_size);
+}
+
+//------------------------------------------------------------------------------
+// Инициализация — вызывает создатель сегмента (родитель) до fork().
+// space — событие писателя в том же сегменте или NULL (своё событие кольца).
+static inline void ring_init(shm_ring_t *r, uint32_t slot_count, uint32_t slot_size, sync_event_t *space)
+{
+    r->slot_count = slot_count;
+    r->slot_size = slot_size;
+    atomic_store(&r->head, 0);
+    atomic_store(&r->tail, 0);
+    r->cached_tail = 0;
+    r->cached_head = 0;
+    sync_event_init(&r->data);
+    sync_event_init(&r->space);
+    atomic_store(&r->closed, 0);
+    if (!space) {
+        space = &r->space;
+    }
+    r->space_off = (int64_t)((char *)space - (char *)r);
+}
+
+static inline sync_event_t *ring_space_event(shm_ring_t *r)
+{
+    return (sync_event_t *)((char *)r + r->space_off);
+}
+
+//------------------------------------------------------------------------------
+// Производитель: получить свободный слот без ожидания (NULL — кольцо полно).
+// Строку пишем прямо в слот, затем вызываем ring_publish().
+static inline ring_slot_t *ring_try_acquire_slot(shm_ring_t *r)
+{
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+    if (head - r->cached_tail >= r->slot_count) {
+        r->cached_tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+        if (head - r->cached_tail >= r->slot_count) {
+            return NULL;
+        }
+    }
+
+    return ring_slot(r, head);
+}
+
+// Производитель: поспать, пока потребитель не освободит слот или кто-то
+// не подаст сигнал в событие писателя (ring_wake_producer()).
+// seq — значение ring_producer_seq(), прочитанное ДО проверки прочих условий
+// (например, канала ошибок): если между проверкой и сном что-то произошло,
+// seq уже изменился и ожидание сразу вернётся.
+static inline uint32_t ring_producer_seq(shm_ring_t *r)
+{
+    return sync_event_seq(ring_space_event(r));
+}
+
+static inline void ring_wait_space(shm_ring_t *r, uint32_t seq)
+{
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (head - atomic_load(&r->tail) >= r->slot_count) {
+        sync_event_wait(ring_space_event(r), seq, -1);
+    }
+}
+
+static inline void ring_publish(shm_ring_t *r)
+{
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    atomic_store(&r->head, head + 1);
+    sync_event_signal(&r->data);
+}
+
+// Сообщаем потребителю, что данных больше не будет.
+// head при закрытии не меняется, поэтому будим через seq события data:
+// иначе пробуждение между проверкой closed и сном потерялось бы.
+static inline void ring_close(shm_ring_t *r)
+{
+    atomic_store(&r->closed, 1);
+    sync_event_signal(&r->data);
+}
+
+// Разбудить ждущего в ring_wait_space() писателя, не освобождая слот —
+// например, чтобы он обслужил канал ошибок, пока кольцо полно
+static inline void ring_wake_producer(shm_ring_t *r)
+{
+    sync_event_signal(ring_space_event(r));
+}
+
+//------------------------------------------------------------------------------
+// Потребитель: дождаться очередного слота. NULL — кольцо закрыто и пусто.
+// Слот принадлежит потребителю до вызова ring_release().
+static inline ring_slot_t *ring_peek(shm_ring_t *r)
+{
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+    while (r->cached_head == tail) {
+        // Снимок seq — до проверки head и closed: publish и close меняют
+        // своё условие раньше, чем seq, поэтому ни одно не проскочит мимо
+        uint32_t seq = sync_event_seq(&r->data);
+        r->cached_head = atomic_load_explicit(&r->head, memory_order_acquire);
+        if (r->cached_head != tail) {
+            break;
+        }
+        if (atomic_load(&r->closed)) {
+            // closed выставляется после последнего publish — перечитаем head
+            r->cached_head = atomic_load_explicit(&r->head, memory_order_acquire);
+            if (r->cached_head != tail) {
+                break;
+            }
+            return NULL;
+        }
+        sync_event_wait(&r->data, seq, -1);
+    }
+
+    return ring_slot(r, tail);
+}
+
+// Потребитель: подождать данных не дольше timeout_ns. 1 — ring_peek() не
+// заснёт (есть слот или кольцо закрыто), 0 — время вышло или ложное
+// пробуждение. Нужно, чтобы между пачками успеть сделать свою работу по
+// таймеру (например, сбросить буфер записи).
+static inline int ring_wait_data(shm_ring_t *r, long timeout_ns)
+{
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (r->cached_head != tail) {
+        return 1;
+    }
+    uint32_t seq = sync_event_seq(&r->data);
+    r->cached_head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (r->cached_head != tail || atomic_load(&r->closed)) {
+        return 1;
+    }
+    sync_event_wait(&r->data, seq, timeout_ns);
+    r->cached_head = atomic_load_explicit(&r->head, memory_order_acquire);
+    return r->cached_head != tail || atomic_load(&r->closed);
+}
+
+static inline void ring_release(shm_ring_t *r)
+{
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    atomic_store(&r->tail, tail + 1);
+    sync_event_signal(ring_space_event(r));
+}
+
+#endif // POSIX_IPC_SHM_RING_H
@@ -0,0 +1,117 @@
+#ifndef POSIX_IPC_SHM_SYNC_H
+#define POSIX_IPC_SHM_SYNC_H
+
+// ----------------------------------------------
+// Синхронизация процессов через слова в разделяемой памяти (вместо
+// именованных семафоров).
+//
+// Событие (sync_event_t) — счётчик seq. Ждущий читает seq ДО проверки своего
+// условия (есть место в кольце, пришла ошибка...) и, если условие ложно,
+// спит, пока seq не изменится. Тот, кто меняет условие, сначала меняет его,
+// затем увеличивает seq — так пробуждение не теряется, сколько бы разных
+// условий ни сигналило в одно событие.
+//
+// Ожидание адаптивное: сначала короткий спин (строки обычно приходят
+// пачками, и соседний процесс отвечает за микросекунды), затем futex.
+// Длина спина подстраивается: удачный спин её удваивает, уход в futex —
+// уменьшает вдвое, так что на одном ядре спин быстро сходит на нет.
+//
+// Всё живёт внутри сегмента — после падения процесса в /dev/shm не
+// остаётся семафоров.
+// ----------------------------------------------
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#define SYNC_SPIN_MIN   16
+#define SYNC_SPIN_MAX   4096
+
+typedef struct {
+    _Atomic uint32_t seq;         // futex-слово: растёт при каждом сигнале
+    _Atomic uint32_t waiters;     // сколько процессов спит в futex
+    _Atomic uint32_t spin;        // текущая длина спина (подсказка, гонки не страшны)
+} sync_event_t;
+
+//------------------------------------------------------------------------------
+// Обёртки над futex. Флаг FUTEX_PRIVATE_FLAG не ставим: слово лежит
+// в MAP_SHARED-памяти и разделяется между процессами.
+static inline int sync_futex_wait(_Atomic uint32_t *addr, uint32_t expected, const struct timespec *timeout)
+{
+    return (int)syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT, expected, timeout, NULL, 0);
+}
+
+static inline void sync_futex_wake(_Atomic uint32_t *addr, int count)
+{
+    syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+static inline void sync_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Инициализация — вызывает создатель сегмента до fork()
+static inline void sync_event_init(sync_event_t *ev)
+{
+    atomic_store(&ev->seq, 0);
+    atomic_store(&ev->waiters, 0);
+    atomic_store(&ev->spin, SYNC_SPIN_MIN);
+}
+
+// Снимок счётчика — читать до проверки условия
+static inline uint32_t sync_event_seq(sync_event_t *ev)
+{
+    return atomic_load(&ev->seq);
+}
+
+// Условие изменилось: увеличиваем seq и будим всех спящих (если есть)
+static inline void sync_event_signal(sync_event_t *ev)
+{
+    atomic_fetch_add(&ev->seq, 1);
+    if (atomic_load(&ev->waiters)) {
+        sync_futex_wake(&ev->seq, INT_MAX);
+    }
+}
+
+// Ждать, пока seq отличается от снимка. timeout_ns < 0 — без ограничения.
+// Возвращает 0, если вышло время, иначе 1 (возможно ложное пробуждение —
+// условие всё равно перепроверяет вызывающий).
+static inline int sync_event_wait(sync_event_t *ev, uint32_t seq, long timeout_ns)
+{
+    uint32_t spin = atomic_load_explicit(&ev->spin, memory_order_relaxed);
+    for (uint32_t i = 0; i < spin; i++) {
+        if (atomic_load_explicit(&ev->seq, memory_order_acquire) != seq) {
+            if (spin < SYNC_SPIN_MAX) {
+                atomic_store_explicit(&ev->spin, spin * 2, memory_order_relaxed);
+            }
+            return 1;
+        }
+        sync_cpu_relax();
+    }
+    if (spin > SYNC_SPIN_MIN) {
+        atomic_store_explicit(&ev->spin, spin / 2, memory_order_relaxed);
+    }
+
+    // Пара seq_cst-операций (waiters здесь, seq в sync_event_signal)
+    // гарантирует: либо сигнальщик увидит нас, либо futex увидит новый seq
+    struct timespec timeout = {timeout_ns / 1000000000L, timeout_ns % 1000000000L};
+    atomic_fetch_add(&ev->waiters, 1);
+    int rc = sync_futex_wait(&ev->seq, seq, timeout_ns < 0 ? NULL : &timeout);
+    atomic_fetch_sub(&ev->waiters, 1);
+
+    if (rc == -1 && errno == ETIMEDOUT) {
+        return atomic_load(&ev->seq) != seq;
+    }
+    return 1;
+}
+
+#endif // POSIX_IPC_SHM_SYNC_H
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+/*
+ * Двоичный аллокатор-близнец (buddy system, Knowlton).
+ *
+ * Блок порядка k — 2^k байт по смещению, кратному 2^k. Близнец блока —
+ * соседний блок того же размера, с которым он вместе образует блок порядка
+ * k + 1; его смещение — offset ^ 2^k. Запрос округляется вверх до степени
+ * двойки (порядок — через clz). Если свободного блока нужного порядка нет,
+ * делится ближайший больший: непустые порядки отмечены битами в
+ * free_mask, и ближайший ищется одним find-first-set. При освобождении
+ * блок сливается с близнецом, пока тот свободен, и поднимается на порядок
+ * выше. И выделение, и освобождение — не больше чем по шагу на порядок,
+ * O(log N), а свободные близнецы всегда слиты.
+ *
+ * Свободен ли блок, говорит битовая карта его порядка (бит на блок) —
+ * проверка близнеца не трогает сам близнец. Свободные блоки порядка ещё
+ * и в двусвязном списке через свои первые слова: взять любой или вынуть
+ * близнеца при слиянии — O(1). Порядок занятого блока записан в байтовой
+ * карте (байт на минимальный блок), поэтому заголовков у блоков нет.
+ *
+ * Служебные данные (сам аллокатор и карты) лежат в начале пула. Остаток
+ * не обязан быть степенью двойки: он делится на наибольшие выровненные
+ * блоки, а у блока, близнец которого вышел бы за конец, слияние просто
+ * останавливается.
+ */
+
+#define MIN_ORDER 5                      // Минимальный блок — 32 байта
+#define MAX_ORDERS 64                    // Порядков не больше, чем бит в free_mask
+#define ORDER_SIZE(order) ((size_t)1 << (order))
+
+typedef struct FreeBlock {
+    struct FreeBlock* next;
+    struct FreeBlock* prev;
+} FreeBlock;
+
+typedef struct Allocator {
+    void* memory;                        // Начало области блоков (смещение 0)
+    size_t size;                         // Её размер
+    unsigned max_order;                  // Порядок самого большого блока
+    uint64_t free_mask;                  // Бит k — есть свободные блоки порядка k
+    FreeBlock* free_lists[MAX_ORDERS];
+    uint64_t* free_bits[MAX_ORDERS];     // Бит i — свободен блок i порядка k
+    uint8_t* orders;                     // Порядок занятого блока по его первому минимальному блоку
+} Allocator;
+
+// Порядок для size: ceil(log2(size)), не меньше MIN_ORDER
+static unsigned order_for(size_t size) {
+    if (size <= ORDER_SIZE(MIN_ORDER)) {
+        return MIN_ORDER;
+    }
+    return (unsigned)(sizeof(unsigned long) * 8 - __builtin_clzl(size - 1));
+}
+
+static size_t offset_of(Allocator* allocator, void* block) {
+    return (size_t)((char*)block - (char*)allocator->memory);
+}
+
+static int test_free(Allocator* allocator, size_t offset, unsigned order) {
+    size_t index = offset >> order;
+    return (allocator->free_bits[order][index / 64] >> (index % 64)) & 1;
+}
+
+static void push_block(Allocator* allocator, size_t offset, unsigned order) {
+    size_t index = offset >> order;
+    allocator->free_bits[order][index / 64] |= (uint64_t)1 << (index % 64);
+
+    FreeBlock* block = (FreeBlock*)((char*)allocator->memory + offset);
+    block->prev = NULL;
+    block->next = allocator->free_lists[order];
+    if (block->next != NULL) {
+        block->next->prev = block;
+    }
+    allocator->free_lists[order] = block;
+    allocator->free_mask |= (uint64_t)1 << order;
+}
+
+static void remove_block(Allocator* allocator, FreeBlock* block, unsigned order) {
+    size_t index = offset_of(allocator, block) >> order;
+    allocator->free_bits[order][index / 64] &= ~((uint64_t)1 << (index % 64));
+
+    if (block->prev != NULL) {
+        block->prev->next = block->next;
+    } else {
+        allocator->free_lists[order] = block->next;
+        if (block->next == NULL) {
+            allocator->free_mask &= ~((uint64_t)1 << order);
+        }
+    }
+    if (block->next != NULL) {
+        block->next->prev = block->prev;
+    }
+}
+
+Allocator* allocator_create(void* memory, size_t size) {
+    if (memory == NULL || size < sizeof(Allocator)) {
+        return NULL;
+    }
+
+    // Карты считаем на весь пул — блоков в области не больше
+    uintptr_t cursor = (uintptr_t)memory + sizeof(Allocator);
+    uintptr_t end = (uintptr_t)memory + size;
+    unsigned max_order = MIN_ORDER;
+    while (max_order + 1 < MAX_ORDERS && ORDER_SIZE(max_order + 1) <= size) {
+        max_order++;
+    }
+
+    Allocator* allocator = (Allocator*)memory;
+    memset(allocator, 0, sizeof(Allocator));
+    for (unsigned order = MIN_ORDER; order <= max_order; order++) {
+        size_t words = (size >> order) / 64 + 1;
+        cursor = (cursor + sizeof(uint64_t) - 1) & ~(uintptr_t)(sizeof(uint64_t) - 1);
+        allocator->free_bits[order] = (uint64_t*)cursor;
+        cursor += words * sizeof(uint64_t);
+    }
+    allocator->orders = (uint8_t*)cursor;
+    cursor += (size >> MIN_ORDER) + 1;
+
+    uintptr_t begin = (cursor + ORDER_SIZE(MIN_ORDER) - 1) & ~(uintptr_t)(ORDER_SIZE(MIN_ORDER) - 1);
+    if (begin + ORDER_SIZE(MIN_ORDER) > end) {
+        return NULL;
+    }
+    memset((void*)allocator->free_bits[MIN_ORDER], 0, (size_t)(begin - (uintptr_t)allocator->free_bits[MIN_ORDER]));
+    allocator->memory = (void*)begin;
+    allocator->size = (size_t)(end - begin) & ~(ORDER_SIZE(MIN_ORDER) - 1);
+    allocator->max_order = max_order;
+
+    // Область — в наибольшие блоки, выровненные по своему размеру
+    size_t offset = 0;
+    while (offset + ORDER_SIZE(MIN_ORDER) <= allocator->size) {
+        unsigned order = max_order;
+        while (order > MIN_ORDER && ((offset & (ORDER_SIZE(order) - 1)) != 0 || offset + ORDER_SIZE(order) > allocator->size)) {
+            order--;
+        }
+        push_block(allocator, offset, order);
+        offset += ORDER_SIZE(order);
+    }
+
+    return allocator;
+}
+
+void allocator_destroy(Allocator* allocator) {
+    if (allocator == NULL) {
+        return;
+    }
+
+    allocator->memory = NULL;
+    allocator->size = 0;
+    allocator->free_mask = 0;
+}
+
+void* allocator_alloc(Allocator* allocator, size_t size) {
+    if (allocator == NULL || size == 0 || size > allocator->size) {
+        return NULL;
+    }
+
+    // Ближайший непустой порядок не меньше нужного — find-first-set
+    unsigned order = order_for(size);
+    uint64_t available = order < MAX_ORDERS ? allocator->free_mask >> order : 0;
+    if (available == 0) {
+        return NULL;
+    }
+    unsigned found = order + (unsigned)__builtin_ctzll(available);
+
+    FreeBlock* block = allocator->free_lists[found];
+    remove_block(allocator, block, found);
+
+    // Лишнее отдаём половинами: вторая половина каждого деления — свободный близнец
+    size_t offset = offset_of(allocator, block);
+    while (found > order) {
+        found--;
+        push_block(allocator, offset + ORDER_SIZE(found), found);
+    }
+
+    allocator->orders[offset >> MIN_ORDER] = (uint8_t)order;
+    return block;
+}
+
+void allocator_free(Allocator* allocator, void* memory) {
+    if (allocator == NULL || memory == NULL) {
+        return;
+    }
+
+    size_t offset = offset_of(allocator, memory);
+    unsigned order = allocator->orders[offset >> MIN_ORDER];
+
+    // Сливаемся с близнецом, пока он целиком свободен
+    while (order < allocator->max_order) {
+        size_t buddy = offset ^ ORDER_SIZE(order);
+        if (buddy + ORDER_SIZE(order) > allocator->size || !test_free(allocator, buddy, order)) {
+            break;
+        }
+        remove_block(allocator, (FreeBlock*)((char*)allocator->memory + buddy), order);
+        offset &= ~ORDER_SIZE(order);
+        order++;
+    }
+
+    push_block(allocator, offset, order);
+}
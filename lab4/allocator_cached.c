@@ -0,0 +1,392 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+/*
+ * Потокобезопасная надстройка с кэшами потоков (магазинами, как в slab
+ * Бонвика) над любым из аллокаторов lab4.
+ *
+ * Сам аллокатор-основа (backend) однопоточный; это библиотека с тем же
+ * интерфейсом, её путь — в переменной окружения ALLOCATOR_BACKEND (по
+ * умолчанию ./allocator_mckusick.so) или аргументом allocator_create_backend.
+ * Пул целиком отдаётся ей, все вызовы основы — под одним мьютексом.
+ *
+ * Маленькие блоки (вместе с заголовком до 2^MAX_CLASS байт) округляются
+ * до степени двойки — это класс блока. У каждого потока на каждый класс
+ * свой магазин — стек из MAGAZINE_SIZE недавно освобождённых блоков;
+ * alloc и free работают с ним без блокировок. Пустой магазин пополняется
+ * сразу пачкой из BATCH_SIZE блоков, переполненный сбрасывает пачку.
+ * Пачки лежат в общем стеке своего класса (central) под отдельным
+ * мьютексом класса, и стек меняется целой пачкой за раз — на поток
+ * приходится одна блокировка на BATCH_SIZE операций, и потоки разных
+ * классов друг другу не мешают. Только если общий стек пуст, пачка
+ * берётся у основы; если в нём уже CENTRAL_MAX_BATCHES пачек, лишняя
+ * возвращается основе. А если у основы кончилась память, ей отдаются все
+ * пачки общих стеков и магазины вызвавшего потока (reclaim), и запрос
+ * повторяется — память не застревает в кэшах. Магазины других потоков
+ * так не достать: у них остаётся не больше MAGAZINE_SIZE блоков на класс.
+ *
+ * Блок, выделенный в одном потоке, можно освобождать в другом: он просто
+ * попадёт в магазин освобождающего потока. Когда поток завершается, его
+ * магазины сбрасываются в общие стеки (деструктор ключа потока).
+ *
+ * Класс блока записан в заголовке перед памятью пользователя (HEADER_SIZE
+ * байт, выравнивание на 16 сохраняется): основа может быть и без
+ * заголовков, а free() должен знать класс. Большие запросы идут прямо
+ * в основу.
+ *
+ * allocator_destroy нельзя вызывать, пока другие потоки ещё работают
+ * с аллокатором.
+ *
+ * Сборка:
+ *     gcc -O2 -shared -fPIC -pthread -o allocator_cached.so allocator_cached.c -ldl
+ */
+
+#define MIN_CLASS 5                        // Блок 32 байта: заголовок и ссылки свободного блока
+#define MAX_CLASS 12                       // Блоки больше 4 КБ не кэшируются
+#define NUM_CLASSES (MAX_CLASS - MIN_CLASS + 1)
+#define LARGE_CLASS 0                      // Класс в заголовке блока, взятого прямо у основы
+#define HEADER_SIZE 16
+#define MAGAZINE_SIZE 64
+#define BATCH_SIZE (MAGAZINE_SIZE / 2)
+#define CENTRAL_MAX_BATCHES 16
+#define CACHE_LINE 64
+#define DEFAULT_BACKEND "./allocator_mckusick.so"
+
+// Свободный блок: класс на месте заголовка, дальше — ссылки пачки
+typedef struct FreeBlock {
+    size_t class_index;
+    struct FreeBlock* next;        // Следующий блок пачки
+    struct FreeBlock* next_batch;  // Следующая пачка стека (только у первого блока)
+    size_t count;                  // Блоков в пачке (только у первого блока)
+} FreeBlock;
+
+typedef struct Magazine {
+    size_t count;
+    FreeBlock* blocks[MAGAZINE_SIZE];
+} Magazine;
+
+typedef struct ThreadCache {
+    struct ThreadCache* next;      // Все кэши аллокатора — для allocator_destroy
+    struct ThreadCache* next_spare;
+    struct Allocator* allocator;
+    Magazine magazines[NUM_CLASSES];
+} ThreadCache;
+
+// Общий стек пачек класса; на своей линии кэша, чтобы классы не делили её
+typedef struct Central {
+    _Alignas(CACHE_LINE) pthread_mutex_t lock;
+    FreeBlock* batches;
+    size_t batch_count;
+} Central;
+
+typedef struct Allocator {
+    Central central[NUM_CLASSES];
+
+    _Alignas(CACHE_LINE) pthread_mutex_t backend_lock;
+    void* backend;
+    void* library;
+    void* (*backend_create)(void*, size_t);
+    void (*backend_destroy)(void*);
+    void* (*backend_alloc)(void*, size_t);
+    void (*backend_free)(void*, void*);
+
+    pthread_key_t key;             // Кэш текущего потока
+    pthread_mutex_t caches_lock;
+    ThreadCache* caches;
+    ThreadCache* spare_caches;     // Кэши завершившихся потоков, для новых потоков
+} Allocator;
+
+// Класс для блока size байт (с заголовком): ceil(log2(size)), не меньше MIN_CLASS
+static unsigned class_for(size_t size) {
+    if (size <= ((size_t)1 << MIN_CLASS)) {
+        return MIN_CLASS;
+    }
+    return (unsigned)(sizeof(unsigned long) * 8 - __builtin_clzl(size - 1));
+}
+
+//------------------------------------------------------------------------------
+// Основа и общие стеки
+
+// Блоки — основе, под её мьютексом
+static void backend_release(Allocator* allocator, FreeBlock** blocks, size_t count) {
+    pthread_mutex_lock(&allocator->backend_lock);
+    for (size_t i = 0; i < count; i++) {
+        allocator->backend_free(allocator->backend, blocks[i]);
+    }
+    pthread_mutex_unlock(&allocator->backend_lock);
+}
+
+// Пополнить пустой магазин: пачка из общего стека, а если он пуст — у основы
+static void refill(Allocator* allocator, unsigned class_index, Magazine* magazine) {
+    Central* central = &allocator->central[class_index - MIN_CLASS];
+
+    pthread_mutex_lock(&central->lock);
+    FreeBlock* batch = central->batches;
+    if (batch != NULL) {
+        central->batches = batch->next_batch;
+        central->batch_count--;
+    }
+    pthread_mutex_unlock(&central->lock);
+
+    if (batch != NULL) {
+        for (FreeBlock* block = batch; block != NULL; block = block->next) {
+            magazine->blocks[magazine->count++] = block;
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&allocator->backend_lock);
+    while (magazine->count < BATCH_SIZE) {
+        FreeBlock* block = (FreeBlock*)allocator->backend_alloc(allocator->backend, (size_t)1 << class_index);
+        if (block == NULL) {
+            break;
+        }
+        block->class_index = class_index;
+        magazine->blocks[magazine->count++] = block;
+    }
+    pthread_mutex_unlock(&allocator->backend_lock);
+}
+
+// Сбросить count верхних блоков магазина одной пачкой в общий стек
+static void flush(Allocator* allocator, unsigned class_index, Magazine* magazine, size_t count) {
+    Central* central = &allocator->central[class_index - MIN_CLASS];
+    FreeBlock** blocks = &magazine->blocks[magazine->count - count];
+    magazine->count -= count;
+
+    // Пачку связываем до захвата мьютекса
+    for (size_t i = 0; i + 1 < count; i++) {
+        blocks[i]->next = blocks[i + 1];
+    }
+    blocks[count - 1]->next = NULL;
+    blocks[0]->count = count;
+
+    pthread_mutex_lock(&central->lock);
+    if (central->batch_count < CENTRAL_MAX_BATCHES) {
+        blocks[0]->next_batch = central->batches;
+        central->batches = blocks[0];
+        central->batch_count++;
+        pthread_mutex_unlock(&central->lock);
+        return;
+    }
+    pthread_mutex_unlock(&central->lock);
+
+    backend_release(allocator, blocks, count);
+}
+
+/*
+ * У основы кончилась память: вернуть ей все пачки общих стеков и магазины
+ * потока cache (если он есть). Пачки снимаются со стека целиком под его
+ * мьютексом, а основе отдаются уже без него.
+ */
+static void reclaim(Allocator* allocator, ThreadCache* cache) {
+    for (unsigned class_index = MIN_CLASS; class_index <= MAX_CLASS; class_index++) {
+        if (cache != NULL) {
+            Magazine* magazine = &cache->magazines[class_index - MIN_CLASS];
+            backend_release(allocator, magazine->blocks, magazine->count);
+            magazine->count = 0;
+        }
+
+        Central* central = &allocator->central[class_index - MIN_CLASS];
+        pthread_mutex_lock(&central->lock);
+        FreeBlock* batch = central->batches;
+        central->batches = NULL;
+        central->batch_count = 0;
+        pthread_mutex_unlock(&central->lock);
+
+        pthread_mutex_lock(&allocator->backend_lock);
+        while (batch != NULL) {
+            FreeBlock* next_batch = batch->next_batch;
+            for (FreeBlock* block = batch; block != NULL;) {
+                FreeBlock* next = block->next;
+                allocator->backend_free(allocator->backend, block);
+                block = next;
+            }
+            batch = next_batch;
+        }
+        pthread_mutex_unlock(&allocator->backend_lock);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Кэши потоков
+
+// Поток завершился: его блоки — в общие стеки, кэш — в запас
+static void release_cache(void* value) {
+    ThreadCache* cache = (ThreadCache*)value;
+    Allocator* allocator = cache->allocator;
+
+    for (unsigned class_index = MIN_CLASS; class_index <= MAX_CLASS; class_index++) {
+        Magazine* magazine = &cache->magazines[class_index - MIN_CLASS];
+        if (magazine->count > 0) {
+            flush(allocator, class_index, magazine, magazine->count);
+        }
+    }
+
+    pthread_mutex_lock(&allocator->caches_lock);
+    cache->next_spare = allocator->spare_caches;
+    allocator->spare_caches = cache;
+    pthread_mutex_unlock(&allocator->caches_lock);
+}
+
+static ThreadCache* thread_cache(Allocator* allocator) {
+    ThreadCache* cache = (ThreadCache*)pthread_getspecific(allocator->key);
+    if (cache != NULL) {
+        return cache;
+    }
+
+    // Первое обращение потока: берём кэш из запаса или заводим новый
+    pthread_mutex_lock(&allocator->caches_lock);
+    cache = allocator->spare_caches;
+    if (cache != NULL) {
+        allocator->spare_caches = cache->next_spare;
+    }
+    pthread_mutex_unlock(&allocator->caches_lock);
+
+    if (cache == NULL) {
+        cache = (ThreadCache*)mmap(NULL, sizeof(ThreadCache), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+        if (cache == MAP_FAILED) {
+            return NULL;
+        }
+        cache->allocator = allocator;
+        pthread_mutex_lock(&allocator->caches_lock);
+        cache->next = allocator->caches;
+        allocator->caches = cache;
+        pthread_mutex_unlock(&allocator->caches_lock);
+    }
+
+    pthread_setspecific(allocator->key, cache);
+    return cache;
+}
+
+//------------------------------------------------------------------------------
+
+Allocator* allocator_create_backend(void* memory, size_t size, const char* backend_path) {
+    if (memory == NULL) {
+        return NULL;
+    }
+
+    Allocator* allocator = (Allocator*)mmap(NULL, sizeof(Allocator), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (allocator == MAP_FAILED) {
+        return NULL;
+    }
+
+    allocator->library = dlopen(backend_path ? backend_path : DEFAULT_BACKEND, RTLD_NOW | RTLD_LOCAL);
+    if (allocator->library == NULL) {
+        fprintf(stderr, "Error: Unable to load the backend allocator: %s\n", dlerror());
+        munmap(allocator, sizeof(Allocator));
+        return NULL;
+    }
+    allocator->backend_create = dlsym(allocator->library, "allocator_create");
+    allocator->backend_destroy = dlsym(allocator->library, "allocator_destroy");
+    allocator->backend_alloc = dlsym(allocator->library, "allocator_alloc");
+    allocator->backend_free = dlsym(allocator->library, "allocator_free");
+    if (!allocator->backend_create || !allocator->backend_destroy || !allocator->backend_alloc || !allocator->backend_free) {
+        dlclose(allocator->library);
+        munmap(allocator, sizeof(Allocator));
+        return NULL;
+    }
+
+    allocator->backend = allocator->backend_create(memory, size);
+    if (allocator->backend == NULL || pthread_key_create(&allocator->key, release_cache) != 0) {
+        dlclose(allocator->library);
+        munmap(allocator, sizeof(Allocator));
+        return NULL;
+    }
+
+    pthread_mutex_init(&allocator->backend_lock, NULL);
+    pthread_mutex_init(&allocator->caches_lock, NULL);
+    for (size_t i = 0; i < NUM_CLASSES; i++) {
+        pthread_mutex_init(&allocator->central[i].lock, NULL);
+    }
+    // Остальные поля — нули из mmap
+    return allocator;
+}
+
+Allocator* allocator_create(void* memory, size_t size) {
+    return allocator_create_backend(memory, size, getenv("ALLOCATOR_BACKEND"));
+}
+
+void allocator_destroy(Allocator* allocator) {
+    if (allocator == NULL) {
+        return;
+    }
+
+    // Блоки в кэшах и стеках основе не возвращаем: она уничтожается целиком
+    pthread_key_delete(allocator->key);
+    while (allocator->caches != NULL) {
+        ThreadCache* next = allocator->caches->next;
+        munmap(allocator->caches, sizeof(ThreadCache));
+        allocator->caches = next;
+    }
+
+    allocator->backend_destroy(allocator->backend);
+    dlclose(allocator->library);
+
+    pthread_mutex_destroy(&allocator->backend_lock);
+    pthread_mutex_destroy(&allocator->caches_lock);
+    for (size_t i = 0; i < NUM_CLASSES; i++) {
+        pthread_mutex_destroy(&allocator->central[i].lock);
+    }
+    munmap(allocator, sizeof(Allocator));
+}
+
+void* allocator_alloc(Allocator* allocator, size_t size) {
+    if (allocator == NULL || size == 0 || size > SIZE_MAX - HEADER_SIZE) {
+        return NULL;
+    }
+
+    unsigned class_index = class_for(size + HEADER_SIZE);
+    ThreadCache* cache = class_index <= MAX_CLASS ? thread_cache(allocator) : NULL;
+    if (cache == NULL) {
+        // Большой блок (или кэш потока не завёлся) — прямо у основы
+        for (int attempt = 0; attempt < 2; attempt++) {
+            pthread_mutex_lock(&allocator->backend_lock);
+            FreeBlock* block = (FreeBlock*)allocator->backend_alloc(allocator->backend, size + HEADER_SIZE);
+            pthread_mutex_unlock(&allocator->backend_lock);
+            if (block != NULL) {
+                block->class_index = LARGE_CLASS;
+                return (char*)block + HEADER_SIZE;
+            }
+            reclaim(allocator, (ThreadCache*)pthread_getspecific(allocator->key));
+        }
+        return NULL;
+    }
+
+    Magazine* magazine = &cache->magazines[class_index - MIN_CLASS];
+    if (magazine->count == 0) {
+        refill(allocator, class_index, magazine);
+        if (magazine->count == 0) {
+            reclaim(allocator, cache);
+            refill(allocator, class_index, magazine);
+        }
+        if (magazine->count == 0) {
+            return NULL;
+        }
+    }
+    return (char*)magazine->blocks[--magazine->count] + HEADER_SIZE;
+}
+
+void allocator_free(Allocator* allocator, void* memory) {
+    if (allocator == NULL || memory == NULL) {
+        return;
+    }
+
+    FreeBlock* block = (FreeBlock*)((char*)memory - HEADER_SIZE);
+    unsigned class_index = (unsigned)block->class_index;
+    ThreadCache* cache = class_index != LARGE_CLASS ? thread_cache(allocator) : NULL;
+    if (cache == NULL) {
+        backend_release(allocator, &block, 1);
+        return;
+    }
+
+    Magazine* magazine = &cache->magazines[class_index - MIN_CLASS];
+    if (magazine->count == MAGAZINE_SIZE) {
+        flush(allocator, class_index, magazine, BATCH_SIZE);
+    }
+    magazine->blocks[magazine->count++] = block;
+}
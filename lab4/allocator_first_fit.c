@@ -1,61 +1,262 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <sys/mman.h>
 
+/*
+ * Блоки с граничными тегами (Кнут): в начале каждого блока заголовок —
+ * размер блока целиком и два флага (блок занят, предыдущий блок занят).
+ * У свободного блока размер повторён ещё и в последнем слове (footer),
+ * поэтому при освобождении и правый сосед (по заголовку), и левый (по его
+ * footer'у, если флаг говорит, что он свободен) находятся за O(1).
+ * Свободные блоки связаны в двусвязный список прямо в своём теле — любой
+ * из них вынимается из списка за O(1), и слияние тоже O(1).
+ *
+ * Занятый блок тратит на служебное только заголовок (8 байт). Блоки
+ * выровнены так, что память, которую получает пользователь, кратна 16.
+ * Пул ограничен: перед первым блоком — ничего (у него стоит флаг
+ * "предыдущий занят"), после последнего — заголовок нулевого размера с
+ * флагом "занят", дальше которого слияние не идёт.
+ *
+ * Стратегия поиска выбирается при создании:
+ *     first — первый подходящий с начала списка (по умолчанию);
+ *     next  — первый подходящий, начиная с места прошлого поиска;
+ *     best  — самый маленький из подходящих.
+ * allocator_create берёт её из переменной окружения ALLOCATOR_POLICY
+ * (интерфейс dlopen в main.c не даёт передать параметр), напрямую —
+ * allocator_create_policy.
+ */
+
+#define ALIGNMENT 16
+#define HEADER_SIZE sizeof(size_t)
+#define ALIGN_UP(value, alignment) (((value) + ((alignment) - 1)) & ~((size_t)(alignment) - 1))
+
+#define FLAG_ALLOCATED ((size_t)1)
+#define FLAG_PREV_ALLOCATED ((size_t)2)
+#define SIZE_MASK (~(size_t)(ALIGNMENT - 1))
+
+typedef enum Policy {
+    POLICY_FIRST_FIT,
+    POLICY_NEXT_FIT,
+    POLICY_BEST_FIT
+} Policy;
+
 typedef struct Block {
-    size_t size;
-    struct Block* next;
+    size_t header;        // размер блока с заголовком | флаги
+    struct Block* next;   // дальше — только у свободных блоков
+    struct Block* prev;
 } Block;
 
+// Свободный блок должен вместить заголовок, два указателя и footer
+#define MIN_BLOCK_SIZE ALIGN_UP(sizeof(Block) + sizeof(size_t), ALIGNMENT)
+
 typedef struct Allocator{
     void* memory;
     size_t size;
     Block* free_list;
+    Block* rover;         // next-fit: с какого блока продолжать поиск
+    Policy policy;
 } Allocator;
 
-Allocator* allocator_create(void* memory, size_t size) {
+static size_t block_size(const Block* block) {
+    return block->header & SIZE_MASK;
+}
+
+static Block* next_block(Block* block) {
+    return (Block*)((char*)block + block_size(block));
+}
+
+static size_t* block_footer(Block* block) {
+    return (size_t*)((char*)block + block_size(block)) - 1;
+}
+
+// Свободный блок: заголовок и footer с размером, флаг "предыдущий занят" сохраняется
+static void mark_free(Block* block, size_t size) {
+    block->header = size | (block->header & FLAG_PREV_ALLOCATED);
+    *block_footer(block) = size;
+    next_block(block)->header &= ~FLAG_PREV_ALLOCATED;
+}
+
+static void mark_allocated(Block* block, size_t size) {
+    block->header = size | FLAG_ALLOCATED | (block->header & FLAG_PREV_ALLOCATED);
+    next_block(block)->header |= FLAG_PREV_ALLOCATED;
+}
+
+static void list_insert(Allocator* allocator, Block* block) {
+    block->prev = NULL;
+    block->next = allocator->free_list;
+    if (allocator->free_list) {
+        allocator->free_list->prev = block;
+    }
+    allocator->free_list = block;
+}
+
+static void list_remove(Allocator* allocator, Block* block) {
+    if (allocator->rover == block) {
+        allocator->rover = block->next;
+    }
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        allocator->free_list = block->next;
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+}
+
+static Policy policy_from_name(const char* name) {
+    if (name && strcmp(name, "next") == 0) {
+        return POLICY_NEXT_FIT;
+    }
+    if (name && strcmp(name, "best") == 0) {
+        return POLICY_BEST_FIT;
+    }
+    return POLICY_FIRST_FIT;
+}
+
+Allocator* allocator_create_policy(void* memory, size_t size, const char* policy) {
+    if (memory == NULL) {
+        return NULL;
+    }
+
+    // Первый заголовок — за 8 байт до границы 16, последние 8 байт — на
+    // заголовок-ограничитель
+    uintptr_t begin = ALIGN_UP((uintptr_t)memory + HEADER_SIZE, ALIGNMENT) - HEADER_SIZE;
+    uintptr_t end = ((uintptr_t)memory + size - HEADER_SIZE) & SIZE_MASK;
+    end -= ALIGNMENT - HEADER_SIZE;
+    if (size < 2 * MIN_BLOCK_SIZE || end <= begin || end - begin < MIN_BLOCK_SIZE) {
+        return NULL;
+    }
+
     Allocator* allocator = (Allocator*)mmap(NULL, sizeof(Allocator), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (allocator == MAP_FAILED) {
+        return NULL;
+    }
     allocator->memory = memory;
     allocator->size = size;
-    allocator->free_list = (Block*)memory;
-    allocator->free_list->size = size;
-    allocator->free_list->next = NULL;
+    allocator->free_list = NULL;
+    allocator->rover = NULL;
+    allocator->policy = policy_from_name(policy);
+
+    Block* first = (Block*)begin;
+    Block* epilogue = (Block*)end;
+    epilogue->header = FLAG_ALLOCATED;
+    first->header = FLAG_PREV_ALLOCATED;
+    mark_free(first, end - begin);
+    list_insert(allocator, first);
     return allocator;
 }
 
+Allocator* allocator_create(void* memory, size_t size) {
+    return allocator_create_policy(memory, size, getenv("ALLOCATOR_POLICY"));
+}
+
 void allocator_destroy(Allocator* allocator) {
-    munmap(allocator, sizeof(Allocator));
+    if (allocator) {
+        munmap(allocator, sizeof(Allocator));
+    }
 }
 
-void* allocator_alloc(Allocator* allocator, size_t size) {
-    Block* prev = NULL;
-    Block* curr = allocator->free_list;
-
-    while (curr != NULL) {
-        if (curr->size >= size) {
-            if (curr->size > size + sizeof(Block)) {
-                Block* new_block = (Block*)((char*)curr + sizeof(Block) + size);
-                new_block->size = curr->size - size - sizeof(Block);
-                new_block->next = curr->next;
-                curr->size = size;
-                curr->next = new_block;
+static Block* find_first_fit(Block* from, Block* to, size_t size) {
+    for (Block* curr = from; curr != to; curr = curr->next) {
+        if (block_size(curr) >= size) {
+            return curr;
+        }
+    }
+    return NULL;
+}
+
+static Block* find_fit(Allocator* allocator, size_t size) {
+    switch (allocator->policy) {
+        case POLICY_NEXT_FIT: {
+            Block* found = find_first_fit(allocator->rover, NULL, size);
+            if (!found) {
+                found = find_first_fit(allocator->free_list, allocator->rover, size);
             }
-            if (prev == NULL) {
-                allocator->free_list = curr->next;
-            } else {
-                prev->next = curr->next;
+            return found;
+        }
+        case POLICY_BEST_FIT: {
+            Block* best = NULL;
+            for (Block* curr = allocator->free_list; curr != NULL; curr = curr->next) {
+                if (block_size(curr) >= size && (!best || block_size(curr) < block_size(best))) {
+                    best = curr;
+                    if (block_size(curr) == size) {
+                        break;
+                    }
+                }
             }
-            return (void*)((char*)curr + sizeof(Block));
+            return best;
         }
-        prev = curr;
-        curr = curr->next;
+        default:
+            return find_first_fit(allocator->free_list, NULL, size);
     }
-    return NULL;
+}
+
+void* allocator_alloc(Allocator* allocator, size_t size) {
+    if (allocator == NULL || size == 0 || size > allocator->size) {
+        return NULL;
+    }
+
+    size_t needed = ALIGN_UP(size + HEADER_SIZE, ALIGNMENT);
+    if (needed < MIN_BLOCK_SIZE) {
+        needed = MIN_BLOCK_SIZE;
+    }
+
+    Block* block = find_fit(allocator, needed);
+    if (block == NULL) {
+        return NULL;
+    }
+
+    Block* after = block->next;
+    list_remove(allocator, block);
+
+    // Остаток, в который влезает свободный блок, отрезаем и возвращаем в
+    // список; next-fit продолжит поиск с него
+    size_t rest = block_size(block) - needed;
+    if (rest >= MIN_BLOCK_SIZE) {
+        mark_allocated(block, needed);
+        Block* tail = next_block(block);
+        tail->header = FLAG_PREV_ALLOCATED;
+        mark_free(tail, rest);
+        list_insert(allocator, tail);
+        after = tail;
+    } else {
+        mark_allocated(block, block_size(block));
+    }
+    if (allocator->policy == POLICY_NEXT_FIT) {
+        allocator->rover = after;
+    }
+
+    return (void*)((char*)block + HEADER_SIZE);
 }
 
 void allocator_free(Allocator* allocator, void* memory) {
-    Block* block = (Block*)((char*)memory - sizeof(Block));
-    block->next = allocator->free_list;
-    allocator->free_list = block;
-}
\ No newline at end of file
+    if (allocator == NULL || memory == NULL) {
+        return;
+    }
+
+    Block* block = (Block*)((char*)memory - HEADER_SIZE);
+    size_t size = block_size(block);
+
+    // Правый сосед свободен — забираем его себе
+    Block* right = next_block(block);
+    if (!(right->header & FLAG_ALLOCATED)) {
+        list_remove(allocator, right);
+        size += block_size(right);
+    }
+
+    // Левый сосед свободен — его размер в footer'е прямо перед нами
+    if (!(block->header & FLAG_PREV_ALLOCATED)) {
+        size_t left_size = *((size_t*)block - 1);
+        Block* left = (Block*)((char*)block - left_size);
+        list_remove(allocator, left);
+        size += left_size;
+        block = left;
+    }
+
+    block->header &= ~FLAG_ALLOCATED;
+    mark_free(block, size);
+    list_insert(allocator, block);
+}
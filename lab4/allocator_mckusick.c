@@ -1,52 +1,263 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <sys/mman.h>
 
-#define ALIGN_SIZE(size, alignment) (((size) + (alignment - 1)) & ~(alignment - 1))
-#define FREE_LIST_ALIGNMENT 8
-#define NUM_FREE_LISTS 32 // Количество списков для блоков разного размера
+/*
+ * Аллокатор Маккьюзика-Карелса (4.3BSD/4.4BSD malloc ядра).
+ *
+ * Пул режется на страницы по PAGE_SIZE. Маленький запрос (не больше
+ * половины страницы) округляется вверх до степени двойки — это его корзина
+ * (bucket); страница корзины целиком нарезана на объекты одного размера.
+ * Свободные объекты корзины лежат в односвязном списке через своё первое
+ * слово. Большой запрос получает несколько страниц подряд (run).
+ *
+ * Заголовков у объектов нет: по адресу вычисляется номер страницы, а массив
+ * описателей страниц (kmemusage) говорит, к какой корзине страница
+ * относится или сколько страниц в большом блоке. Поэтому free() не нужно
+ * ничего, кроме указателя, а корзина по размеру находится через clz.
+ * Маленькие alloc и free — O(1): снять или положить голову списка.
+ *
+ * Свободные серии страниц слиты максимально: длина серии записана в
+ * описателях первой и последней её страницы, соседние серии находятся за
+ * O(1) и при освобождении сразу сливаются. Сами серии — в двусвязном
+ * списке, страницы берутся из первой подходящей.
+ *
+ * Как и в BSD, страница, отданная корзине, обратно сразу не возвращается:
+ * освобождённые объекты остаются в корзине для следующих запросов того же
+ * размера. Только если страниц на новый запрос не хватило, корзины
+ * просматриваются, и страницы, все объекты которых свободны, возвращаются
+ * в общий запас (reclaim_pages).
+ */
 
-typedef struct Block {
-    size_t size;
-    struct Block* next;
-} Block;
+#define PAGE_SHIFT 12
+#define PAGE_SIZE ((size_t)1 << PAGE_SHIFT)
+#define MIN_BUCKET 4                  // Самый маленький объект — 16 байт
+#define MAX_BUCKET (PAGE_SHIFT - 1)   // Самый большой — полстраницы
+#define NUM_BUCKETS (MAX_BUCKET + 1)  // Индекс корзины = log2 размера объекта
+
+typedef enum PageKind {
+    PAGE_FREE,    // Свободная серия: count — её длина (в первой и последней странице)
+    PAGE_BUCKET,  // Страница корзины index: count — свободных объектов в ней
+    PAGE_RUN,     // Первая страница большого блока: count — страниц в нём
+    PAGE_INSIDE   // Прочие страницы большого блока или свободной серии
+} PageKind;
+
+// Описатель страницы (kmemusage в BSD)
+typedef struct PageUsage {
+    uint8_t kind;
+    uint8_t index;
+    uint32_t count;
+} PageUsage;
+
+typedef struct Object {
+    struct Object* next;
+} Object;
+
+// Свободная серия страниц хранит ссылки на соседей по списку в себе
+typedef struct FreeRun {
+    struct FreeRun* next;
+    struct FreeRun* prev;
+} FreeRun;
 
 typedef struct Allocator {
-    void* memory;
+    void* memory;                    // Первая страница пула
     size_t size;
-    Block* free_lists[NUM_FREE_LISTS]; // Массив списков свободных блоков
+    size_t page_count;
+    PageUsage* usage;                // Описатели страниц (лежат в начале пула)
+    Object* buckets[NUM_BUCKETS];    // Свободные объекты по корзинам
+    FreeRun* free_runs;              // Свободные серии страниц
 } Allocator;
 
-// Функция для определения индекса в массиве free_lists
-size_t get_free_list_index(size_t size) {
-    size_t index = 0;
-    while (size > (1 << (index + FREE_LIST_ALIGNMENT))) {
-        index++;
+// Номер корзины для размера: ceil(log2(size)), не меньше MIN_BUCKET
+static unsigned bucket_index(size_t size) {
+    if (size <= ((size_t)1 << MIN_BUCKET)) {
+        return MIN_BUCKET;
+    }
+    return (unsigned)(sizeof(unsigned long) * 8 - __builtin_clzl(size - 1));
+}
+
+static char* page_address(Allocator* allocator, size_t page) {
+    return (char*)allocator->memory + (page << PAGE_SHIFT);
+}
+
+static size_t page_number(Allocator* allocator, void* address) {
+    return (size_t)((char*)address - (char*)allocator->memory) >> PAGE_SHIFT;
+}
+
+//------------------------------------------------------------------------------
+// Серии страниц
+
+/*
+ * Отметить серию [page, page + count) свободной и добавить в список.
+ * Меняются только описатели крайних страниц: внутренние страницы любой
+ * серии всегда помечены PAGE_INSIDE.
+ */
+static void push_run(Allocator* allocator, size_t page, size_t count) {
+    allocator->usage[page].kind = PAGE_FREE;
+    allocator->usage[page].count = (uint32_t)count;
+    allocator->usage[page + count - 1].kind = PAGE_FREE;
+    allocator->usage[page + count - 1].count = (uint32_t)count;
+
+    FreeRun* run = (FreeRun*)page_address(allocator, page);
+    run->prev = NULL;
+    run->next = allocator->free_runs;
+    if (run->next != NULL) {
+        run->next->prev = run;
+    }
+    allocator->free_runs = run;
+}
+
+static void unlink_run(Allocator* allocator, FreeRun* run) {
+    if (run->prev != NULL) {
+        run->prev->next = run->next;
+    } else {
+        allocator->free_runs = run->next;
+    }
+    if (run->next != NULL) {
+        run->next->prev = run->prev;
     }
-    return index < NUM_FREE_LISTS ? index : NUM_FREE_LISTS - 1;
 }
 
+// count страниц подряд; возвращает номер первой или page_count, если нет
+static size_t take_pages(Allocator* allocator, size_t count) {
+    for (FreeRun* run = allocator->free_runs; run != NULL; run = run->next) {
+        size_t page = page_number(allocator, run);
+        size_t length = allocator->usage[page].count;
+        if (length < count) {
+            continue;
+        }
+
+        // Берём начало серии, хвост остаётся свободным
+        unlink_run(allocator, run);
+        if (length > count) {
+            push_run(allocator, page + count, length - count);
+        }
+        if (count > 1) {
+            allocator->usage[page + count - 1].kind = PAGE_INSIDE;
+        }
+        return page;
+    }
+    return allocator->page_count;
+}
+
+/*
+ * Вернуть серию страниц в запас, слив с соседними свободными сериями: их
+ * первая (справа) и последняя (слева) страницы прилегают к нашей. Крайние
+ * страницы сливаемых серий становятся внутренними.
+ */
+static void release_pages(Allocator* allocator, size_t page, size_t count) {
+    allocator->usage[page].kind = PAGE_INSIDE;
+
+    size_t after = page + count;
+    if (after < allocator->page_count && allocator->usage[after].kind == PAGE_FREE) {
+        size_t length = allocator->usage[after].count;
+        unlink_run(allocator, (FreeRun*)page_address(allocator, after));
+        allocator->usage[after].kind = PAGE_INSIDE;
+        allocator->usage[after + length - 1].kind = PAGE_INSIDE;
+        count += length;
+    }
+    if (page > 0 && allocator->usage[page - 1].kind == PAGE_FREE) {
+        size_t length = allocator->usage[page - 1].count;
+        allocator->usage[page - 1].kind = PAGE_INSIDE;
+        page -= length;
+        unlink_run(allocator, (FreeRun*)page_address(allocator, page));
+        allocator->usage[page].kind = PAGE_INSIDE;
+        count += length;
+    }
+    push_run(allocator, page, count);
+}
+
+//------------------------------------------------------------------------------
+// Корзины
+
+/*
+ * Страниц не хватило: убрать из корзин объекты страниц, которые свободны
+ * целиком, и вернуть эти страницы в запас. Проход по всем свободным
+ * объектам, но только на этом редком пути.
+ */
+static void reclaim_pages(Allocator* allocator) {
+    for (unsigned index = MIN_BUCKET; index < NUM_BUCKETS; index++) {
+        uint32_t per_page = (uint32_t)(PAGE_SIZE >> index);
+        Object** link = &allocator->buckets[index];
+        while (*link != NULL) {
+            PageUsage* usage = &allocator->usage[page_number(allocator, *link)];
+            if (usage->count == per_page) {
+                *link = (*link)->next;
+            } else {
+                link = &(*link)->next;
+            }
+        }
+    }
+    for (size_t page = 0; page < allocator->page_count; page++) {
+        PageUsage* usage = &allocator->usage[page];
+        if (usage->kind == PAGE_BUCKET && usage->count == (uint32_t)(PAGE_SIZE >> usage->index)) {
+            release_pages(allocator, page, 1);
+        }
+    }
+}
+
+// Разрезать новую страницу на объекты корзины index
+static int refill_bucket(Allocator* allocator, unsigned index) {
+    size_t page = take_pages(allocator, 1);
+    if (page == allocator->page_count) {
+        return 0;
+    }
+
+    size_t object_size = (size_t)1 << index;
+    size_t per_page = PAGE_SIZE >> index;
+    allocator->usage[page].kind = PAGE_BUCKET;
+    allocator->usage[page].index = (uint8_t)index;
+    allocator->usage[page].count = (uint32_t)per_page;
+
+    // Объекты — в список по возрастанию адресов
+    char* base = page_address(allocator, page);
+    for (size_t i = 0; i < per_page; i++) {
+        Object* object = (Object*)(base + i * object_size);
+        object->next = i + 1 < per_page ? (Object*)(base + (i + 1) * object_size) : allocator->buckets[index];
+    }
+    allocator->buckets[index] = (Object*)base;
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+
 Allocator* allocator_create(void* memory, size_t size) {
     if (memory == NULL || size < sizeof(Allocator)) {
         return NULL;
     }
 
+    // В начале пула — сам аллокатор и описатели страниц, дальше страницы,
+    // выровненные на PAGE_SIZE (объекты корзин тогда выровнены на свой размер)
     Allocator* allocator = (Allocator*)memory;
-    allocator->memory = (char*)memory + sizeof(Allocator);
-    allocator->size = size - sizeof(Allocator);
-
-    // Инициализация всех списков свободных блоков
-    for (size_t i = 0; i < NUM_FREE_LISTS; i++) {
-        allocator->free_lists[i] = NULL;
+    uintptr_t end = (uintptr_t)memory + size;
+    uintptr_t usage = (uintptr_t)memory + sizeof(Allocator);
+    size_t page_count = (size - sizeof(Allocator)) / (PAGE_SIZE + sizeof(PageUsage));
+    uintptr_t pages = 0;
+    while (page_count > 0) {
+        pages = (usage + page_count * sizeof(PageUsage) + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1);
+        if (pages + page_count * PAGE_SIZE <= end) {
+            break;
+        }
+        page_count--;
+    }
+    if (page_count == 0) {
+        return NULL;
     }
 
-    // Добавляем всю доступную память в список для максимального размера
-    size_t index = get_free_list_index(allocator->size);
-    Block* initial_block = (Block*)allocator->memory;
-    initial_block->size = allocator->size;
-    initial_block->next = allocator->free_lists[index];
-    allocator->free_lists[index] = initial_block;
+    allocator->memory = (void*)pages;
+    allocator->size = page_count * PAGE_SIZE;
+    allocator->page_count = page_count;
+    allocator->usage = (PageUsage*)usage;
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        allocator->buckets[i] = NULL;
+    }
+    allocator->free_runs = NULL;
+    for (size_t i = 0; i < page_count; i++) {
+        allocator->usage[i].kind = PAGE_INSIDE;
+    }
+    push_run(allocator, 0, page_count);
 
     return allocator;
 }
@@ -58,56 +269,43 @@ void allocator_destroy(Allocator* allocator) {
 
     allocator->memory = NULL;
     allocator->size = 0;
-    for (size_t i = 0; i < NUM_FREE_LISTS; i++) {
-        allocator->free_lists[i] = NULL;
-    }
+    allocator->page_count = 0;
+    allocator->free_runs = NULL;
 }
 
 void* allocator_alloc(Allocator* allocator, size_t size) {
-    if (allocator == NULL || size == 0) {
+    if (allocator == NULL || size == 0 || size > allocator->size) {
         return NULL;
     }
 
-    size_t aligned_size = ALIGN_SIZE(size, FREE_LIST_ALIGNMENT);
-    size_t index = get_free_list_index(aligned_size);
-
-    // Ищем подходящий блок в списке
-    while (index < NUM_FREE_LISTS) {
-        Block* prev = NULL;
-        Block* curr = allocator->free_lists[index];
-
-        while (curr != NULL) {
-            if (curr->size >= aligned_size) {
-                // Нашли подходящий блок
-                if (prev != NULL) {
-                    prev->next = curr->next;
-                } else {
-                    allocator->free_lists[index] = curr->next;
-                }
-
-                // Если остаток блока достаточно большой, разделяем его
-                if (curr->size > aligned_size + sizeof(Block)) {
-                    Block* new_block = (Block*)((char*)curr + sizeof(Block) + aligned_size);
-                    new_block->size = curr->size - sizeof(Block) - aligned_size;
-                    size_t new_index = get_free_list_index(new_block->size);
-                    new_block->next = allocator->free_lists[new_index];
-                    allocator->free_lists[new_index] = new_block;
-
-                    curr->size = aligned_size;
-                }
-
-                return (void*)((char*)curr + sizeof(Block));
+    // Большой запрос — целые страницы
+    if (size > (PAGE_SIZE >> 1)) {
+        size_t count = (size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        size_t page = take_pages(allocator, count);
+        if (page == allocator->page_count) {
+            reclaim_pages(allocator);
+            page = take_pages(allocator, count);
+            if (page == allocator->page_count) {
+                return NULL;
             }
-
-            prev = curr;
-            curr = curr->next;
         }
+        allocator->usage[page].kind = PAGE_RUN;
+        allocator->usage[page].count = (uint32_t)count;
+        return page_address(allocator, page);
+    }
 
-        // Переходим к следующему списку с блоками большего размера
-        index++;
+    unsigned index = bucket_index(size);
+    if (allocator->buckets[index] == NULL && !refill_bucket(allocator, index)) {
+        reclaim_pages(allocator);
+        if (!refill_bucket(allocator, index)) {
+            return NULL;
+        }
     }
 
-    return NULL; // Не удалось найти подходящий блок
+    Object* object = allocator->buckets[index];
+    allocator->buckets[index] = object->next;
+    allocator->usage[page_number(allocator, object)].count--;
+    return object;
 }
 
 void allocator_free(Allocator* allocator, void* memory) {
@@ -115,33 +313,16 @@ void allocator_free(Allocator* allocator, void* memory) {
         return;
     }
 
-    Block* block = (Block*)((char*)memory - sizeof(Block));
-    size_t index = get_free_list_index(block->size);
-
-    // Добавляем освобождённый блок в соответствующий список
-    block->next = allocator->free_lists[index];
-    allocator->free_lists[index] = block;
-
-    // Слияние соседних свободных блоков
-    for (size_t i = 0; i < NUM_FREE_LISTS; i++) {
-        Block* curr = allocator->free_lists[i];
-        while (curr != NULL && curr->next != NULL) {
-            if ((char*)curr + sizeof(Block) + curr->size == (char*)curr->next) {
-                // Сливаем два соседних блока
-                curr->size += sizeof(Block) + curr->next->size;
-                curr->next = curr->next->next;
-
-                // Перемещаем объединённый блок в соответствующий список
-                size_t new_index = get_free_list_index(curr->size);
-                if (new_index != i) {
-                    Block* merged_block = curr;
-                    curr = curr->next; // Продолжаем обход
-                    merged_block->next = allocator->free_lists[new_index];
-                    allocator->free_lists[new_index] = merged_block;
-                }
-            } else {
-                curr = curr->next;
-            }
-        }
+    // Что это за память, знает описатель её страницы
+    size_t page = page_number(allocator, memory);
+    PageUsage* usage = &allocator->usage[page];
+    if (usage->kind == PAGE_RUN) {
+        release_pages(allocator, page, usage->count);
+        return;
     }
-}
\ No newline at end of file
+
+    Object* object = (Object*)memory;
+    object->next = allocator->buckets[usage->index];
+    allocator->buckets[usage->index] = object;
+    usage->count++;
+}
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#define ALIGN_SIZE(size, alignment) (((size) + (alignment - 1)) & ~(alignment - 1))
+#define FREE_LIST_ALIGNMENT 8
+#define NUM_FREE_LISTS 32 // Количество списков для блоков разного размера
+
+/*
+ * Слияние — по граничным тегам: в заголовке блока размер и флаги "занят"
+ * и "предыдущий занят", у свободного блока размер повторён в последнем
+ * слове. Соседи освобождаемого блока находятся по адресу за O(1), а
+ * списки свободных блоков двусвязные — соседа можно вынуть из его списка
+ * тоже за O(1), не обходя списки.
+ *
+ * Размеры блоков кратны BLOCK_ALIGNMENT, пользователь получает память,
+ * выровненную на 16. После последнего блока — заголовок нулевого размера
+ * с флагом "занят": дальше слияние не идёт.
+ */
+#define BLOCK_ALIGNMENT 16
+#define HEADER_SIZE sizeof(size_t)
+#define FLAG_ALLOCATED ((size_t)1)
+#define FLAG_PREV_ALLOCATED ((size_t)2)
+#define SIZE_MASK (~(size_t)(BLOCK_ALIGNMENT - 1))
+
+typedef struct Block {
+    size_t header;      // Размер блока вместе с заголовком | флаги
+    struct Block* next; // Указатели — только у свободного блока
+    struct Block* prev;
+} Block;
+
+// Свободный блок вмещает заголовок, указатели и копию размера в конце
+#define MIN_BLOCK_SIZE ALIGN_SIZE(sizeof(Block) + sizeof(size_t), BLOCK_ALIGNMENT)
+
+typedef struct Allocator {
+    void* memory;
+    size_t size;
+    Block* free_lists[NUM_FREE_LISTS]; // Массив списков свободных блоков
+} Allocator;
+
+// Функция для определения индекса в массиве free_lists
+size_t get_free_list_index(size_t size) {
+    size_t index = 0;
+    while (size > ((size_t)1 << (index + FREE_LIST_ALIGNMENT))) {
+        index++;
+    }
+    return index < NUM_FREE_LISTS ? index : NUM_FREE_LISTS - 1;
+}
+
+static size_t block_size(const Block* block) {
+    return block->header & SIZE_MASK;
+}
+
+static Block* next_block(Block* block) {
+    return (Block*)((char*)block + block_size(block));
+}
+
+// Пометить блок свободным размера size и вставить в список его размера
+static void push_free(Allocator* allocator, Block* block, size_t size) {
+    block->header = size | (block->header & FLAG_PREV_ALLOCATED);
+    *((size_t*)((char*)block + size) - 1) = size;
+    next_block(block)->header &= ~FLAG_PREV_ALLOCATED;
+
+    size_t index = get_free_list_index(size);
+    block->prev = NULL;
+    block->next = allocator->free_lists[index];
+    if (block->next != NULL) {
+        block->next->prev = block;
+    }
+    allocator->free_lists[index] = block;
+}
+
+// Вынуть свободный блок из его списка
+static void unlink_free(Allocator* allocator, Block* block) {
+    if (block->prev != NULL) {
+        block->prev->next = block->next;
+    } else {
+        allocator->free_lists[get_free_list_index(block_size(block))] = block->next;
+    }
+    if (block->next != NULL) {
+        block->next->prev = block->prev;
+    }
+}
+
+Allocator* allocator_create(void* memory, size_t size) {
+    if (memory == NULL || size < sizeof(Allocator)) {
+        return NULL;
+    }
+
+    Allocator* allocator = (Allocator*)memory;
+
+    // Первый заголовок — за 8 байт до границы 16, в конце — место под
+    // заголовок-ограничитель
+    uintptr_t begin = ALIGN_SIZE((uintptr_t)memory + sizeof(Allocator) + HEADER_SIZE, BLOCK_ALIGNMENT) - HEADER_SIZE;
+    uintptr_t end = (((uintptr_t)memory + size - HEADER_SIZE) & SIZE_MASK) - (BLOCK_ALIGNMENT - HEADER_SIZE);
+    if (end <= begin || end - begin < MIN_BLOCK_SIZE) {
+        return NULL;
+    }
+    allocator->memory = (void*)begin;
+    allocator->size = end - begin;
+
+    // Инициализация всех списков свободных блоков
+    for (size_t i = 0; i < NUM_FREE_LISTS; i++) {
+        allocator->free_lists[i] = NULL;
+    }
+
+    // Вся доступная память — один свободный блок
+    Block* initial_block = (Block*)begin;
+    ((Block*)end)->header = FLAG_ALLOCATED;
+    initial_block->header = FLAG_PREV_ALLOCATED;
+    push_free(allocator, initial_block, allocator->size);
+
+    return allocator;
+}
+
+void allocator_destroy(Allocator* allocator) {
+    if (allocator == NULL) {
+        return;
+    }
+
+    allocator->memory = NULL;
+    allocator->size = 0;
+    for (size_t i = 0; i < NUM_FREE_LISTS; i++) {
+        allocator->free_lists[i] = NULL;
+    }
+}
+
+void* allocator_alloc(Allocator* allocator, size_t size) {
+    if (allocator == NULL || size == 0 || size > allocator->size) {
+        return NULL;
+    }
+
+    size_t aligned_size = ALIGN_SIZE(size + HEADER_SIZE, BLOCK_ALIGNMENT);
+    if (aligned_size < MIN_BLOCK_SIZE) {
+        aligned_size = MIN_BLOCK_SIZE;
+    }
+    size_t index = get_free_list_index(aligned_size);
+
+    // Ищем подходящий блок в списке
+    while (index < NUM_FREE_LISTS) {
+        for (Block* curr = allocator->free_lists[index]; curr != NULL; curr = curr->next) {
+            if (block_size(curr) < aligned_size) {
+                continue;
+            }
+
+            // Нашли подходящий блок
+            unlink_free(allocator, curr);
+
+            // Если остаток блока достаточно большой, разделяем его
+            size_t rest = block_size(curr) - aligned_size;
+            if (rest >= MIN_BLOCK_SIZE) {
+                curr->header = aligned_size | FLAG_ALLOCATED | (curr->header & FLAG_PREV_ALLOCATED);
+                Block* new_block = next_block(curr);
+                new_block->header = FLAG_PREV_ALLOCATED;
+                push_free(allocator, new_block, rest);
+            } else {
+                curr->header |= FLAG_ALLOCATED;
+                next_block(curr)->header |= FLAG_PREV_ALLOCATED;
+            }
+
+            return (void*)((char*)curr + HEADER_SIZE);
+        }
+
+        // Переходим к следующему списку с блоками большего размера
+        index++;
+    }
+
+    return NULL; // Не удалось найти подходящий блок
+}
+
+void allocator_free(Allocator* allocator, void* memory) {
+    if (allocator == NULL || memory == NULL) {
+        return;
+    }
+
+    Block* block = (Block*)((char*)memory - HEADER_SIZE);
+    size_t size = block_size(block);
+
+    // Слияние с правым соседом: он сразу за блоком
+    Block* right = next_block(block);
+    if (!(right->header & FLAG_ALLOCATED)) {
+        unlink_free(allocator, right);
+        size += block_size(right);
+    }
+
+    // Слияние с левым соседом: его размер — в слове прямо перед блоком
+    if (!(block->header & FLAG_PREV_ALLOCATED)) {
+        size_t left_size = *((size_t*)block - 1);
+        Block* left = (Block*)((char*)block - left_size);
+        unlink_free(allocator, left);
+        size += left_size;
+        block = left;
+    }
+
+    // Объединённый блок — в список своего размера
+    block->header &= ~FLAG_ALLOCATED;
+    push_free(allocator, block, size);
+}